@@ -4,71 +4,484 @@
 #include <unistd.h>
 #include <immintrin.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
 #include <iostream>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-static inline unsigned popcount32(uint32_t x) {
+static inline unsigned popcount64(uint64_t x) {
     // Depending on your compiler, you can use __builtin_popcount
     // or __builtin_popcountl, or roll your own. For GCC/Clang:
-    return __builtin_popcount(x);
+    return static_cast<unsigned>(__builtin_popcountll(x));
 }
 
-int main() {
-    // Get size of data from stdin
-    struct stat st;
-    if (fstat(0, &st) < 0) {
-        std::perror("fstat failed");
-        return 1;
-    }
-    if (st.st_size == 0) {
-        std::cout << 0 << std::endl;
-        return 0;
-    }
+// Up to this many target bytes are counted with one vector compare each per
+// block; more than that and a full histogram is cheaper.
+static constexpr size_t MAX_SIMD_TARGETS = 4;
 
-    // Map stdin into memory
-    void* mappedData = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
-    if (mappedData == MAP_FAILED) {
-        std::perror("mmap failed");
-        return 1;
+// Histogram sub-tables per thread. Consecutive bytes go to different tables,
+// so runs of the same value don't serialize on one counter. 4 x 256 x 4 bytes
+// stays in L1.
+static constexpr size_t HIST_LANES = 4;
+
+// The 32-bit sub-table counters are flushed to 64-bit totals after at most
+// this many bytes, long before any single counter could wrap.
+static constexpr size_t HIST_FLUSH_BYTES = size_t(1) << 30;
+
+// ---------------------------------------------------------------------------
+// Counting kernels: count occurrences of each targets[t] in data[0, size)
+// into counts[t]. Every variant is compiled with its own target attribute,
+// so the binary runs on any x86-64 and picks the widest one the CPU has.
+// ---------------------------------------------------------------------------
+using CountKernel = void (*)(const uint8_t* data, size_t size,
+                             const uint8_t* targets, size_t numTargets, uint64_t* counts);
+
+static void countTail(const uint8_t* data, size_t i, size_t size,
+                      const uint8_t* targets, size_t numTargets, uint64_t* counts) {
+    for (; i < size; i++) {
+        for (size_t t = 0; t < numTargets; ++t) {
+            if (data[i] == targets[t]) {
+                ++counts[t];
+            }
+        }
     }
+}
+
+static void countTargetsScalar(const uint8_t* data, size_t size,
+                               const uint8_t* targets, size_t numTargets, uint64_t* counts) {
+    countTail(data, 0, size, targets, numTargets, counts);
+}
 
-    // We expect 8-bit values; st.st_size is the number of bytes
-    const uint8_t* data = static_cast<const uint8_t*>(mappedData);
-    size_t size = static_cast<size_t>(st.st_size);
+// SSE2 and AVX2: subtracting the 0xFF compare result adds 1 per match to a
+// byte lane. After at most 255 blocks the byte lanes are folded into 64-bit
+// totals with sad_epu8, so there is no movemask/popcount per vector.
+static constexpr size_t MAX_BYTE_ACC_BLOCKS = 255;
 
-    // AVX2-based counting
-    const __m256i target = _mm256_set1_epi8(127);
-    uint64_t count = 0;
+__attribute__((target("sse2")))
+static void countTargetsSSE2(const uint8_t* data, size_t size,
+                             const uint8_t* targets, size_t numTargets, uint64_t* counts) {
+    const size_t chunkSize = 16;
+    __m128i target[MAX_SIMD_TARGETS];
+    __m128i total[MAX_SIMD_TARGETS];
+    for (size_t t = 0; t < numTargets; ++t) {
+        target[t] = _mm_set1_epi8(static_cast<char>(targets[t]));
+        total[t]  = _mm_setzero_si128();
+    }
 
-    // Process 32 bytes at a time
+    size_t i = 0;
+    size_t limit = size - (size % chunkSize);
+    while (i < limit) {
+        const size_t stop = std::min(limit, i + MAX_BYTE_ACC_BLOCKS * chunkSize);
+        __m128i acc[MAX_SIMD_TARGETS];
+        for (size_t t = 0; t < numTargets; ++t) {
+            acc[t] = _mm_setzero_si128();
+        }
+        for (; i < stop; i += chunkSize) {
+            __m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            for (size_t t = 0; t < numTargets; ++t) {
+                acc[t] = _mm_sub_epi8(acc[t], _mm_cmpeq_epi8(vec, target[t]));
+            }
+        }
+        for (size_t t = 0; t < numTargets; ++t) {
+            total[t] = _mm_add_epi64(total[t], _mm_sad_epu8(acc[t], _mm_setzero_si128()));
+        }
+    }
+    for (size_t t = 0; t < numTargets; ++t) {
+        counts[t] += static_cast<uint64_t>(_mm_cvtsi128_si64(total[t])) +
+                     static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(total[t], total[t])));
+    }
+    countTail(data, i, size, targets, numTargets, counts);
+}
+
+__attribute__((target("avx2")))
+static void countTargetsAVX2(const uint8_t* data, size_t size,
+                             const uint8_t* targets, size_t numTargets, uint64_t* counts) {
     const size_t chunkSize = 32;
+    __m256i target[MAX_SIMD_TARGETS];
+    __m256i total[MAX_SIMD_TARGETS];
+    for (size_t t = 0; t < numTargets; ++t) {
+        target[t] = _mm256_set1_epi8(static_cast<char>(targets[t]));
+        total[t]  = _mm256_setzero_si256();
+    }
+
     size_t i = 0;
     size_t limit = size - (size % chunkSize);
+    while (i < limit) {
+        const size_t stop = std::min(limit, i + MAX_BYTE_ACC_BLOCKS * chunkSize);
+        __m256i acc[MAX_SIMD_TARGETS];
+        for (size_t t = 0; t < numTargets; ++t) {
+            acc[t] = _mm256_setzero_si256();
+        }
+        for (; i < stop; i += chunkSize) {
+            __m256i vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            for (size_t t = 0; t < numTargets; ++t) {
+                acc[t] = _mm256_sub_epi8(acc[t], _mm256_cmpeq_epi8(vec, target[t]));
+            }
+        }
+        for (size_t t = 0; t < numTargets; ++t) {
+            total[t] = _mm256_add_epi64(total[t], _mm256_sad_epu8(acc[t], _mm256_setzero_si256()));
+        }
+    }
+    for (size_t t = 0; t < numTargets; ++t) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total[t]);
+        counts[t] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    countTail(data, i, size, targets, numTargets, counts);
+}
 
+// AVX-512BW: the compare yields a 64-bit mask directly; one popcount per
+// 64 bytes per target.
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static void countTargetsAVX512(const uint8_t* data, size_t size,
+                               const uint8_t* targets, size_t numTargets, uint64_t* counts) {
+    const size_t chunkSize = 64;
+    __m512i target[MAX_SIMD_TARGETS];
+    for (size_t t = 0; t < numTargets; ++t) {
+        target[t] = _mm512_set1_epi8(static_cast<char>(targets[t]));
+    }
+
+    size_t i = 0;
+    size_t limit = size - (size % chunkSize);
     for (; i < limit; i += chunkSize) {
-        // Load 256 bits
-        __m256i vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
-        // Compare each byte to 127
-        __m256i cmp = _mm256_cmpeq_epi8(vec, target);
-        // Create a bit mask from comparisons
-        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(cmp));
-        // Count how many bytes were equal to 127 in this chunk
-        count += popcount32(mask);
+        __m512i vec = _mm512_loadu_si512(data + i);
+        for (size_t t = 0; t < numTargets; ++t) {
+            counts[t] += popcount64(_mm512_cmpeq_epi8_mask(vec, target[t]));
+        }
     }
+    countTail(data, i, size, targets, numTargets, counts);
+}
 
-    // Process leftover bytes (if size is not multiple of 32)
-    for (; i < size; i++) {
-        if (data[i] == 127) {
-            ++count;
+struct KernelInfo {
+    const char* name;
+    CountKernel fn;
+};
+
+// Widest first, so the first supported entry is the automatic choice.
+static const KernelInfo KERNELS[] = {
+    {"avx512", countTargetsAVX512},
+    {"avx2",   countTargetsAVX2},
+    {"sse2",   countTargetsSSE2},
+    {"scalar", countTargetsScalar},
+};
+
+static bool kernelSupported(const KernelInfo& k) {
+    __builtin_cpu_init();
+    if (k.fn == countTargetsAVX512) {
+        return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("popcnt");
+    }
+    if (k.fn == countTargetsAVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (k.fn == countTargetsSSE2) {
+        return __builtin_cpu_supports("sse2");
+    }
+    return true;
+}
+
+// Resolve a kernel by name ("auto" = widest supported). Returns nullptr if
+// the name is unknown or the CPU lacks the instructions.
+static const KernelInfo* selectKernel(const char* name) {
+    for (const auto& k : KERNELS) {
+        if (std::strcmp(name, "auto") == 0 ? kernelSupported(k)
+                                           : std::strcmp(name, k.name) == 0) {
+            return kernelSupported(k) ? &k : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// Full 256-bin histogram of data[0, size), added into hist.
+static void byteHistogram(const uint8_t* data, size_t size, uint64_t* hist) {
+    uint32_t sub[HIST_LANES][256];
+
+    for (size_t base = 0; base < size; base += HIST_FLUSH_BYTES) {
+        const uint8_t* p = data + base;
+        const size_t len = std::min(HIST_FLUSH_BYTES, size - base);
+        std::memset(sub, 0, sizeof(sub));
+
+        // Eight bytes per load, spread over the sub-tables.
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, p + i, sizeof(w));
+            ++sub[0][w & 0xFF];
+            ++sub[1][(w >> 8) & 0xFF];
+            ++sub[2][(w >> 16) & 0xFF];
+            ++sub[3][(w >> 24) & 0xFF];
+            ++sub[0][(w >> 32) & 0xFF];
+            ++sub[1][(w >> 40) & 0xFF];
+            ++sub[2][(w >> 48) & 0xFF];
+            ++sub[3][w >> 56];
+        }
+        for (; i < len; ++i) {
+            ++sub[0][p[i]];
+        }
+
+        for (size_t l = 0; l < HIST_LANES; ++l) {
+            for (size_t b = 0; b < 256; ++b) {
+                hist[b] += sub[l][b];
+            }
         }
     }
+}
 
-    // Clean up
-    munmap(mappedData, st.st_size);
+// Split [0, size) into page-aligned slices, run `body(ptr, len, out)` on each
+// slice in its own thread with a private 256-entry result, and sum them.
+template <typename Body>
+static void parallelCount(const uint8_t* data, size_t size, unsigned threads,
+                          uint64_t* out, Body body) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t slice = (size + threads - 1) / threads;
+    slice = (slice + page - 1) / page * page;
+
+    std::vector<std::vector<uint64_t>> local(threads, std::vector<uint64_t>(256, 0));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        size_t begin = std::min(size, t * slice);
+        size_t end   = std::min(size, begin + slice);
+        uint64_t* res = local[t].data();
+        if (t + 1 == threads) {
+            body(data + begin, end - begin, res); // the calling thread takes the last slice
+        } else {
+            workers.emplace_back(body, data + begin, end - begin, res);
+        }
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    for (const auto& res : local) {
+        for (size_t b = 0; b < 256; ++b) {
+            out[b] += res[b];
+        }
+    }
+}
+
+// Pipe input is consumed in buffers of this size, two at a time: one being
+// filled by the reader thread while the other is counted.
+static constexpr size_t STREAM_BUFFER_BYTES = size_t(4) << 20;
+
+// Read `fd` until `len` bytes are in `buf` or EOF. Returns the byte count,
+// or -1 on a read error.
+static ssize_t readFull(int fd, uint8_t* buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = ::read(fd, buf + got, len - got);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (r == 0) {
+            break;
+        }
+        got += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(got);
+}
+
+// Streaming counterpart of parallelCount for inputs that can't be mapped
+// (pipes, sockets). A reader thread fills one buffer while `body(ptr, len,
+// out)` runs over the other, so the kernel overlaps the read() calls.
+template <typename Body>
+static bool streamCount(int fd, uint64_t* out, Body body) {
+    // Fewer, larger reads: grow the pipe buffer if the kernel allows it.
+    fcntl(fd, F_SETPIPE_SZ, static_cast<int>(1 << 20));
+
+    struct Slot {
+        std::vector<uint8_t> buf = std::vector<uint8_t>(STREAM_BUFFER_BYTES);
+        ssize_t len = 0;
+        bool full = false;
+    };
+    Slot slots[2];
+    std::mutex m;
+    std::condition_variable cv;
+
+    std::thread reader([&] {
+        for (size_t i = 0;; i ^= 1) {
+            Slot& s = slots[i];
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return !s.full; });
+            }
+            ssize_t len = readFull(fd, s.buf.data(), s.buf.size());
+            {
+                std::lock_guard<std::mutex> lock(m);
+                s.len = len;
+                s.full = true;
+            }
+            cv.notify_all();
+            if (len <= 0 || static_cast<size_t>(len) < s.buf.size()) {
+                return; // EOF or error; the consumer sees it after this slot
+            }
+        }
+    });
+
+    bool ok = true;
+    for (size_t i = 0;; i ^= 1) {
+        Slot& s = slots[i];
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return s.full; });
+        }
+        if (s.len < 0) {
+            std::perror("read failed");
+            ok = false;
+            break;
+        }
+        body(s.buf.data(), static_cast<size_t>(s.len), out);
+        const bool last = static_cast<size_t>(s.len) < s.buf.size();
+        {
+            std::lock_guard<std::mutex> lock(m);
+            s.full = false;
+        }
+        cv.notify_all();
+        if (last) {
+            break;
+        }
+    }
+    reader.join();
+    return ok;
+}
+
+// Parse a comma-separated list of byte values (0..255).
+static bool parseTargets(const char* arg, std::vector<uint8_t>& out) {
+    const char* p = arg;
+    while (*p) {
+        char* end = nullptr;
+        unsigned long v = std::strtoul(p, &end, 0);
+        if (end == p || v > 255) {
+            return false;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+        p = end;
+        if (*p == ',') {
+            ++p;
+        } else if (*p != '\0') {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+int main(int argc, char** argv) {
+    // By default count the byte value 127.
+    //   --targets LIST   count each listed byte value (e.g. "0,10,127")
+    //   --histogram      print all 256 counts, one per line, for bytes 0..255
+    //   --threads T      split the input over T threads (0 = all hardware threads)
+    //   --kernel K       counting kernel: auto (default), avx512, avx2, sse2, scalar
+    std::vector<uint8_t> targets;
+    const char* kernelName = "auto";
+    bool histogram = false;
+    unsigned threads = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--targets") == 0 && i + 1 < argc &&
+            parseTargets(argv[i + 1], targets)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--histogram") == 0) {
+            histogram = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernelName = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--targets LIST | --histogram] [--threads T] [--kernel K]\n";
+            return 1;
+        }
+    }
+    const KernelInfo* kernel = selectKernel(kernelName);
+    if (kernel == nullptr) {
+        std::cerr << "Kernel '" << kernelName << "' is unknown or not supported by this CPU\n";
+        return 1;
+    }
+    const CountKernel countTargets = kernel->fn;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (histogram) {
+        targets.clear();
+        for (unsigned b = 0; b < 256; ++b) {
+            targets.push_back(static_cast<uint8_t>(b));
+        }
+    } else if (targets.empty()) {
+        targets.push_back(127);
+    }
+
+    uint64_t bins[256] = {};
+
+    // Get size of data from stdin
+    struct stat st;
+    if (fstat(0, &st) < 0) {
+        std::perror("fstat failed");
+        return 1;
+    }
+
+    // Regular files are mapped and split across threads; anything else
+    // (e.g. a `zcat | ...` pipe) is streamed through double buffers.
+    auto countInput = [&](auto body) -> bool {
+        uint64_t* out = bins;
+        if (!S_ISREG(st.st_mode)) {
+            return streamCount(0, out, body);
+        }
+        if (st.st_size == 0) {
+            return true;
+        }
+
+        // Map stdin into memory
+        void* mappedData = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+        if (mappedData == MAP_FAILED) {
+            std::perror("mmap failed, falling back to read()");
+            return streamCount(0, out, body);
+        }
+        madvise(mappedData, st.st_size, MADV_SEQUENTIAL);
+
+        // We expect 8-bit values; st.st_size is the number of bytes
+        const uint8_t* data = static_cast<const uint8_t*>(mappedData);
+        size_t size = static_cast<size_t>(st.st_size);
+        parallelCount(data, size, threads, out, body);
+
+        // Clean up
+        munmap(mappedData, st.st_size);
+        return true;
+    };
+
+    // A few targets: vector compares, one pass. Otherwise: histogram.
+    std::vector<uint8_t> unique(targets);
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    bool ok;
+    if (unique.size() <= MAX_SIMD_TARGETS) {
+        ok = countInput(
+            [&unique, countTargets](const uint8_t* p, size_t len, uint64_t* res) {
+                uint64_t counts[MAX_SIMD_TARGETS] = {};
+                countTargets(p, len, unique.data(), unique.size(), counts);
+                for (size_t t = 0; t < unique.size(); ++t) {
+                    res[unique[t]] += counts[t];
+                }
+            });
+    } else {
+        ok = countInput(byteHistogram);
+    }
+    if (!ok) {
+        return 1;
+    }
 
     // Print result
-    std::cout << count << std::endl;
+    for (uint8_t t : targets) {
+        std::cout << bins[t] << '\n';
+    }
+    std::cout << std::flush;
 
     return 0;
 }
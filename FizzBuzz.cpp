@@ -1,38 +1,409 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22 // Linux 5.14+; older kernels reject it harmlessly
+#endif
+
+// Number of decimal digits of x (1..10): floor(log10) estimated from the bit
+// length (1233 / 4096 ~ log10(2)) and corrected with one table lookup.
+static inline unsigned digitCount(uint32_t x) {
+    static const uint32_t POW10[10] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+    };
+    unsigned t = ((32 - __builtin_clz(x | 1)) * 1233) >> 12;
+    return t + 1 - (x < POW10[t]);
+}
+
+// DIGIT_PAIRS.v[p]: the two ASCII digits of p (00..99) as a little-endian
+// uint16, i.e. the tens digit in the low byte.
+struct DigitPairs {
+    uint16_t v[100];
+    DigitPairs() {
+        for (int p = 0; p < 100; ++p) {
+            v[p] = static_cast<uint16_t>(('0' + p / 10) | (('0' + p % 10) << 8));
+        }
+    }
+};
+static const DigitPairs DIGIT_PAIRS;
 
 // A fast routine to convert a 32-bit unsigned integer to decimal string.
 // Returns a pointer to the character after the last written digit.
+//
+// All ten digit positions are built two at a time from the pair table and
+// written forwards in one 16-byte store; shifting the 128-bit text right by
+// the number of leading zeros (known from digitCount) drops them without a
+// branch. Writes 16 bytes at out, so the buffer needs slack.
 static inline char* u32toa(uint32_t x, char* out) {
-    // Temporary buffer to construct the number in reverse
-    // 10 digits are enough for 32-bit (max 4294967295).
-    char buf[11];
-    char* p = buf;
-    do {
-        *p++ = char('0' + (x % 10));
-        x /= 10;
-    } while (x != 0);
-
-    // Now reverse it into 'out'
-    // p points one past the last digit written
-    while (p != buf) {
-        *out++ = *--p;
+    const unsigned len = digitCount(x);
+    const uint32_t hi = x / 100000000;   // digits 1-2 (0..42)
+    const uint32_t lo = x - hi * 100000000;
+    const uint32_t a  = lo / 10000;      // digits 3-6
+    const uint32_t b  = lo - a * 10000;  // digits 7-10
+    const uint64_t low8 = uint64_t(DIGIT_PAIRS.v[a / 100])
+                        | uint64_t(DIGIT_PAIRS.v[a % 100]) << 16
+                        | uint64_t(DIGIT_PAIRS.v[b / 100]) << 32
+                        | uint64_t(DIGIT_PAIRS.v[b % 100]) << 48;
+    unsigned __int128 text = (static_cast<unsigned __int128>(low8) << 16) | DIGIT_PAIRS.v[hi];
+    text >>= 8 * (10 - len);
+    memcpy(out, &text, sizeof(text));
+    return out + len;
+}
+
+// n mod 15 with one multiply-shift (Lemire's fastmod): the low 64 bits of
+// M * n are the fractional part of n / 15 scaled by 2^64, and multiplying
+// them by 15 carries n mod 15 into the high word. Exact for all 32-bit n.
+static inline uint32_t mod15(uint32_t n) {
+    static const uint64_t M = UINT64_C(0xFFFFFFFFFFFFFFFF) / 15 + 1;
+    const uint64_t frac = M * n;
+    return static_cast<uint32_t>((static_cast<unsigned __int128>(frac) * 15) >> 64);
+}
+
+// What to print for each n mod 15: a word, or (len == 0) the number itself.
+struct FizzEntry {
+    alignas(16) char text[16];
+    uint32_t len;
+};
+static const FizzEntry FIZZ_TABLE[15] = {
+    {"FizzBuzz\n", 9}, {"", 0}, {"", 0}, {"Fizz\n", 5}, {"", 0},
+    {"Buzz\n", 5},     {"Fizz\n", 5}, {"", 0}, {"", 0}, {"Fizz\n", 5},
+    {"Buzz\n", 5},     {"", 0}, {"Fizz\n", 5}, {"", 0}, {"", 0},
+};
+
+// Scratch distance for emitFizzBuzz's discarded word store.
+static const size_t WORD_SCRATCH = 32;
+
+// Emit one line for n at out; returns the end of the line. Jump-free: the
+// number is always formatted, and the table word is always stored, either
+// over the digits (word entries) or WORD_SCRATCH bytes further on, where
+// later lines overwrite it (number entries). Both selects are done with a
+// mask rather than ?: because GCC turns the latter into a branch, which
+// mispredicts about half the time on random input. Writes up to
+// WORD_SCRATCH + 16 bytes past out.
+static inline char* emitFizzBuzz(uint32_t n, char* out) {
+    const FizzEntry& e = FIZZ_TABLE[mod15(n)];
+    const size_t numLen = size_t(u32toa(n, out) - out);
+    out[numLen] = '\n';
+    const size_t isNumber = size_t(0) - (e.len == 0);  // all-ones for numbers
+    memcpy(out + (WORD_SCRATCH & isNumber), e.text, sizeof(e.text));
+    return out + (((numLen + 1) & isNumber) | (e.len & ~isNumber));
+}
+
+// A line is at most 11 bytes ("4294967295\n"), and emitFizzBuzz writes up
+// to SLACK bytes past the start of the last line.
+static const size_t MAX_LINE = 11;
+static const size_t SLACK    = WORD_SCRATCH + 16;
+
+// Format count little-endian uint32 values starting at data into out;
+// returns the end of the text. Needs count * MAX_LINE + SLACK bytes at out.
+static char* formatRange(const unsigned char* data, size_t count, char* out) {
+    for (size_t i = 0; i < count; i++) {
+        // Read 4 bytes as little-endian
+        // (On little-endian systems, this reinterpret_cast is fine directly;
+        //  to be fully portable to big-endian, you'd reorder bytes.)
+        uint32_t n;
+        memcpy(&n, data + i*4, 4);
+        out = emitFizzBuzz(n, out);
     }
     return out;
 }
 
+// write() all of [buf, buf + len), retrying short writes and EINTR.
+static bool writeAll(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = ::write(fd, buf, len);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += w;
+        len -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
 // Decide how large our output buffer should be.
 // We'll flush to stdout once this is near full.
 // 8MB is a decent chunk; you can tune as desired.
 static const size_t OUTBUF_SIZE = 8UL * 1024UL * 1024UL;
 
-int main() {
+// Output stage for the serial path: a ring of page-aligned OUTBUF_SIZE
+// buffers drained in order by a writer thread, so the next buffer is being
+// formatted while the previous one goes out and the formatting thread only
+// waits when stdout is slower than it is.
+//
+// When stdout is a pipe, buffers are vmsplice()d: the pipe references our
+// pages instead of copying them. A page may only be refilled once the reader
+// has consumed it, and that is guaranteed once at least the pipe's capacity
+// has been pushed after it, so a buffer is recycled only after lag_ more
+// (full) buffers have been pushed, and the ring is lag_ + 2 deep (one being
+// filled, one being drained). Otherwise buffers go out with write(), and are
+// recycled as soon as they are written. Short writes and EINTR are retried.
+class OutputWriter {
+public:
+    explicit OutputWriter(int fd) : fd_(fd) {
+        struct stat st;
+        if (fstat(fd_, &st) == 0 && S_ISFIFO(st.st_mode)) {
+            // Fewer, larger transfers: grow the pipe if the kernel allows it.
+            fcntl(fd_, F_SETPIPE_SZ, static_cast<int>(1 << 20));
+            int pipeBytes = fcntl(fd_, F_GETPIPE_SZ);
+            if (pipeBytes > 0) {
+                useSplice_ = true;
+                lag_ = size_t(pipeBytes) / OUTBUF_SIZE + 1;
+            }
+        }
+        for (size_t i = 0; i < lag_ + 2; ++i) {
+            void* p = mmap(nullptr, OUTBUF_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+            ring_.push_back(p == MAP_FAILED ? nullptr : static_cast<char*>(p));
+        }
+        len_.resize(ring_.size());
+        if (ok()) {
+            thread_ = std::thread(&OutputWriter::drain, this);
+        }
+    }
+
+    ~OutputWriter() {
+        finish();
+        for (char* p : ring_) {
+            if (p) {
+                munmap(p, OUTBUF_SIZE);
+            }
+        }
+    }
+
+    bool ok() const {
+        return std::find(ring_.begin(), ring_.end(), nullptr) == ring_.end();
+    }
+
+    // Buffer (OUTBUF_SIZE long) to fill next; waits until one is free.
+    // Returns nullptr once a write has failed.
+    char* next() {
+        std::unique_lock<std::mutex> lock(m_);
+        const size_t k = filled_;
+        // Buffer k reuses the slot of buffer k - ring size, which is free
+        // once lag_ buffers after it have been pushed.
+        cv_.wait(lock, [&] {
+            return failed_ || k < ring_.size() || written_ > k - ring_.size() + lag_;
+        });
+        return failed_ ? nullptr : ring_[k % ring_.size()];
+    }
+
+    // Queue the first len bytes of the buffer returned by next().
+    void submit(size_t len) {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            len_[filled_ % ring_.size()] = len;
+            ++filled_;
+        }
+        cv_.notify_all();
+    }
+
+    // Wait for everything queued to be written; false if a write failed
+    // (the writer thread has reported it).
+    bool finish() {
+        if (thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_);
+                done_ = true;
+            }
+            cv_.notify_all();
+            thread_.join();
+        }
+        return !failed_;
+    }
+
+private:
+    void drain() {
+        for (;;) {
+            size_t k;
+            {
+                std::unique_lock<std::mutex> lock(m_);
+                cv_.wait(lock, [&] { return written_ < filled_ || done_; });
+                if (written_ == filled_) {
+                    return;
+                }
+                k = written_;
+            }
+            const bool pushed = push(ring_[k % ring_.size()], len_[k % ring_.size()]);
+            if (!pushed) {
+                perror("write failed on stdout");
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_);
+                failed_ = !pushed;
+                ++written_;
+            }
+            cv_.notify_all();
+            if (!pushed) {
+                return;
+            }
+        }
+    }
+
+    bool push(const char* p, size_t len) {
+        while (len > 0) {
+            ssize_t w;
+            if (useSplice_) {
+                struct iovec iov = {const_cast<char*>(p), len};
+                w = vmsplice(fd_, &iov, 1, 0);
+                if (w < 0 && errno == EINVAL) {
+                    useSplice_ = false; // e.g. not a real pipe; fall back to write
+                    continue;
+                }
+            } else {
+                w = ::write(fd_, p, len);
+            }
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            p   += w;
+            len -= static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    int fd_;
+    bool useSplice_ = false;
+    size_t lag_ = 0;
+    std::vector<char*> ring_;
+    std::vector<size_t> len_;
+    size_t filled_ = 0;  // buffers submitted
+    size_t written_ = 0; // buffers pushed to fd_
+    bool failed_ = false;
+    bool done_ = false;
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+// Values per parallel work item: 1 MB of input, at most ~2.75 MB of text.
+static const size_t CHUNK_VALUES = 256UL * 1024UL;
+
+// Parallel mode: workers claim CHUNK_VALUES-sized input chunks in order and
+// format each into a slot of a ring of 2 * threads buffers; the calling
+// thread writes the slots out in chunk order. A worker may only fill slot
+// c % slots once chunk c - slots has been written, so memory stays at
+// 2 * threads chunk buffers and a slow stdout stalls the workers instead of
+// piling up text. The lowest unwritten chunk's slot is always free, so this
+// cannot deadlock. Each worker prefaults its own input with
+// MADV_POPULATE_READ. Returns false on a write error.
+static bool parallelFizzBuzz(const unsigned char* data, size_t numElements, unsigned threads) {
+    const size_t chunks = (numElements + CHUNK_VALUES - 1) / CHUNK_VALUES;
+    struct Slot {
+        std::unique_ptr<char[]> buf{new char[CHUNK_VALUES * MAX_LINE + SLACK]};
+        size_t len = 0;
+        size_t filled = SIZE_MAX; // chunk whose text is in buf
+        size_t freeFor = 0;       // chunk allowed to fill buf next
+    };
+    const size_t numSlots = 2 * size_t(threads);
+    std::vector<Slot> slots(numSlots);
+    for (size_t i = 0; i < numSlots; ++i) {
+        slots[i].freeFor = i;
+    }
+
+    std::atomic<size_t> nextChunk{0};
+    std::mutex m;
+    std::condition_variable cv;
+    bool failed = false;
+
+    auto worker = [&] {
+        for (;;) {
+            const size_t c = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunks) {
+                return;
+            }
+            Slot& s = slots[c % numSlots];
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return s.freeFor == c || failed; });
+                if (failed) {
+                    return;
+                }
+            }
+            const size_t first = c * CHUNK_VALUES;
+            const size_t count = std::min(CHUNK_VALUES, numElements - first);
+            // Chunks are 1 MB and the mapping is page aligned, so is this.
+            madvise(const_cast<unsigned char*>(data) + first * 4, count * 4, MADV_POPULATE_READ);
+            char* end = formatRange(data + first * 4, count, s.buf.get());
+            {
+                std::lock_guard<std::mutex> lock(m);
+                s.len = size_t(end - s.buf.get());
+                s.filled = c;
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+
+    bool ok = true;
+    for (size_t c = 0; c < chunks; ++c) {
+        Slot& s = slots[c % numSlots];
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return s.filled == c; });
+        }
+        if (!writeAll(STDOUT_FILENO, s.buf.get(), s.len)) {
+            perror("write failed on stdout");
+            ok = false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            s.freeFor = c + numSlots;
+            failed = !ok;
+        }
+        cv.notify_all();
+        if (!ok) {
+            break;
+        }
+    }
+    for (auto& th : pool) {
+        th.join();
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    // "--threads T" formats with T worker threads (0 = all hardware
+    // threads) while the main thread writes; the default is 1, the serial
+    // path. The output is the same either way.
+    unsigned threads = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "Usage: %s [--threads T]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
     // Get size of stdin via fstat
     struct stat st;
     if (fstat(STDIN_FILENO, &st) < 0) {
@@ -49,7 +420,9 @@ int main() {
     // Note: if stdin is not seekable (e.g., a pure pipe),
     // fstat may not return a valid size. Adjust accordingly
     // if your environment differs.
-    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+    // In parallel mode the workers prefault their own chunks.
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ,
+                        MAP_PRIVATE | (threads > 1 ? 0 : MAP_POPULATE), STDIN_FILENO, 0);
     if (mapped == MAP_FAILED) {
         perror("mmap on stdin failed");
         return 1;
@@ -59,72 +432,41 @@ int main() {
     size_t numElements = st.st_size / sizeof(uint32_t);
     auto* dataPtr = static_cast<const unsigned char*>(mapped);
 
-    // Prepare a large output buffer
-    char* outBuf = new char[OUTBUF_SIZE];
-    char* outPtr = outBuf;
+    if (threads > 1) {
+        const bool ok = parallelFizzBuzz(dataPtr, numElements, threads);
+        munmap(mapped, st.st_size);
+        return ok ? 0 : 1;
+    }
 
-    // A lambda to flush the current buffer to stdout
-    auto flushOutput = [&](bool finalFlush = false) {
-        size_t bytesToWrite = outPtr - outBuf;
-        if (bytesToWrite > 0) {
-            ::write(STDOUT_FILENO, outBuf, bytesToWrite);
-        }
-        // Reset outPtr for next chunk
-        outPtr = outBuf;
-        // If it's a final flush, we won't continue writing
-        if (finalFlush) {
-            // no-op here, but could close or do anything else if needed
-        }
-    };
+    // Set up the output stage (a small ring of buffers and a writer thread)
+    OutputWriter out(STDOUT_FILENO);
+    if (!out.ok()) {
+        perror("mmap for output buffers failed");
+        munmap(mapped, st.st_size);
+        return 1;
+    }
 
     // We'll parse each 4-byte chunk as a little-endian uint32_t,
-    // then do the fizzbuzz logic and store strings in our outBuf.
-    // We check for near-full buffer to flush in chunks.
-    for (size_t i = 0; i < numElements; i++) {
-        // Read 4 bytes as little-endian
-        // (On little-endian systems, this reinterpret_cast is fine directly;
-        //  to be fully portable to big-endian, you'd reorder bytes.)
-        uint32_t n;
-        memcpy(&n, dataPtr + i*4, 4);
-
-        // FizzBuzz checks
-        if (n % 15 == 0) {
-            // "FizzBuzz\n"
-            static const char fbStr[] = "FizzBuzz\n";
-            memcpy(outPtr, fbStr, sizeof(fbStr) - 1);
-            outPtr += sizeof(fbStr) - 1;
-        }
-        else if (n % 3 == 0) {
-            // "Fizz\n"
-            static const char fStr[] = "Fizz\n";
-            memcpy(outPtr, fStr, sizeof(fStr) - 1);
-            outPtr += sizeof(fStr) - 1;
-        }
-        else if (n % 5 == 0) {
-            // "Buzz\n"
-            static const char bStr[] = "Buzz\n";
-            memcpy(outPtr, bStr, sizeof(bStr) - 1);
-            outPtr += sizeof(bStr) - 1;
-        }
-        else {
-            // number -> string + newline
-            outPtr = u32toa(n, outPtr);
-            *outPtr++ = '\n';
-        }
-
-        // If the buffer is almost full, flush
-        // (choose a threshold less than OUTBUF_SIZE to avoid overflows).
-        if (size_t(outPtr - outBuf) > (OUTBUF_SIZE - 128)) {
-            flushOutput();
+    // then do the fizzbuzz logic and store strings in an output buffer.
+    // Each buffer takes as many values as are sure to fit, so no per-line
+    // bounds check is needed, and is queued for writing when full.
+    static const size_t BATCH = (OUTBUF_SIZE - SLACK) / MAX_LINE;
+    int rc = 0;
+    for (size_t i = 0; i < numElements; i += BATCH) {
+        char* outBuf = out.next();
+        if (!outBuf) {
+            break;
         }
+        const size_t batch = std::min(numElements - i, BATCH);
+        char* outPtr = formatRange(dataPtr + i*4, batch, outBuf);
+        out.submit(size_t(outPtr - outBuf));
+    }
+    if (!out.finish()) {
+        rc = 1;
     }
-
-    // Final flush
-    flushOutput(/*finalFlush=*/true);
 
     // Clean up
     munmap(mapped, st.st_size);
-    delete[] outBuf;
 
-    return 0;
+    return rc;
 }
@@ -2,36 +2,692 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <immintrin.h>
 
 #include <algorithm>
+#include <cerrno>
+#include <cmath>
 #include <iostream>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
-static constexpr size_t N = 100'000'000;
+// Radix digit widths for the selection engine: the first pass buckets values
+// by their high 16 bits, the second pass resolves the low 16 bits inside the
+// buckets that hold the requested ranks. Both passes only read the
+// input, so it can stay a read-only mapping.
+static constexpr unsigned RADIX_BITS = 16;
+static constexpr size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+static constexpr uint32_t RADIX_MASK = RADIX_BUCKETS - 1;
+
+// Each worker counts into HIST_LANES interleaved copies of its histogram.
+// Runs of equal (or same-bucket) values would otherwise serialize on a
+// store-to-load dependency through a single counter.
+static constexpr size_t HIST_LANES = 4;
+
+// Histogram counters are 32-bit; each worker adds them into the 64-bit
+// totals after at most this many values, long before any could wrap.
+static constexpr size_t HIST_FLUSH_VALUES = size_t(1) << 30;
+
+// Low-bits passes with more than HIST_LANES buckets give every bucket its own
+// 256 KB histogram per thread, up to this many buckets per pass (so p1..p99
+// still resolves in one pass). NO_SLOT marks prefixes nobody asked about.
+static constexpr size_t MAX_PASS_BUCKETS = 128;
+static constexpr uint8_t NO_SLOT = 0xFF;
+
+// Given a merged histogram and a rank k, find the bucket containing the k-th
+// smallest element and turn k into a rank relative to the start of that bucket.
+static uint32_t findBucket(const uint64_t* hist, uint64_t& k) {
+    for (size_t b = 0; b < RADIX_BUCKETS; ++b) {
+        if (k < hist[b]) {
+            return static_cast<uint32_t>(b);
+        }
+        k -= hist[b];
+    }
+    return static_cast<uint32_t>(RADIX_BUCKETS - 1);
+}
+
+// Pass 1 kernel: count data[begin, end) by high 16 bits.
+static void countHigh(const uint32_t* data, size_t begin, size_t end, uint32_t* hist) {
+    size_t i = begin;
+    for (; i + HIST_LANES <= end; i += HIST_LANES) {
+        for (size_t l = 0; l < HIST_LANES; ++l) {
+            ++hist[l * RADIX_BUCKETS + (data[i + l] >> RADIX_BITS)];
+        }
+    }
+    for (; i < end; ++i) {
+        ++hist[data[i] >> RADIX_BITS];
+    }
+}
+
+// Pass 2 kernel: count data[begin, end) by low 16 bits, keeping only values
+// whose high 16 bits equal one of `prefixes` (at most HIST_LANES of them).
+// Each prefix gets its own lane of the histogram; a single prefix rotates
+// over all lanes instead.
+template <bool Single>
+struct LowCounter {
+    const uint32_t* prefixes;
+    size_t count;
+    uint32_t* hist;
+    size_t rotate = 0;
+
+    void add(uint32_t v) {
+        size_t lane = 0;
+        if (Single) {
+            lane = rotate;
+            rotate = (rotate + 1) % HIST_LANES;
+        } else {
+            while (prefixes[lane] != (v >> RADIX_BITS)) {
+                ++lane;
+            }
+        }
+        ++hist[lane * RADIX_BUCKETS + (v & RADIX_MASK)];
+    }
+
+    void scalar(const uint32_t* data, size_t i, size_t end) {
+        for (; i < end; ++i) {
+            uint32_t v = data[i];
+            if (std::find(prefixes, prefixes + count, v >> RADIX_BITS) != prefixes + count) {
+                add(v);
+            }
+        }
+    }
+};
+
+// AVX2 filter: eight values are tested per compare and the (usually empty)
+// match mask is walked bit by bit. Returns where the scalar tail starts.
+template <bool Single>
+__attribute__((target("avx2")))
+static size_t countLowAVX2(const uint32_t* data, size_t i, size_t end, LowCounter<Single>& counter) {
+    __m256i want[HIST_LANES];
+    for (size_t p = 0; p < HIST_LANES; ++p) {
+        want[p] = _mm256_set1_epi32(static_cast<int>(counter.prefixes[p < counter.count ? p : 0]));
+    }
+    for (; i + 8 <= end; i += 8) {
+        __m256i v  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hi = _mm256_srli_epi32(v, RADIX_BITS);
+        __m256i eq = _mm256_cmpeq_epi32(hi, want[0]);
+        if (!Single) {
+            for (size_t p = 1; p < counter.count; ++p) {
+                eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(hi, want[p]));
+            }
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+        while (mask != 0) {
+            counter.add(data[i + __builtin_ctz(mask)]);
+            mask &= mask - 1;
+        }
+    }
+    return i;
+}
+
+template <bool Single>
+static void countLowImpl(const uint32_t* data, size_t begin, size_t end,
+                         const uint32_t* prefixes, size_t count, uint32_t* hist) {
+    LowCounter<Single> counter{prefixes, count, hist};
+    size_t i = begin;
+    if (__builtin_cpu_supports("avx2")) {
+        i = countLowAVX2<Single>(data, i, end, counter);
+    }
+    counter.scalar(data, i, end);
+}
+
+static void countLow(const uint32_t* data, size_t begin, size_t end,
+                     const uint32_t* prefixes, size_t count, uint32_t* hist) {
+    if (count == 1) {
+        countLowImpl<true>(data, begin, end, prefixes, count, hist);
+    } else {
+        countLowImpl<false>(data, begin, end, prefixes, count, hist);
+    }
+}
+
+// Pass 2 kernel for more than HIST_LANES buckets: slotOf maps every high-16
+// prefix to its histogram, so one table lookup replaces the compares. Slots
+// are below 128 and NO_SLOT has the top bit set, so four lookups that all
+// miss (the common case) are rejected with one test.
+static void countLowTable(const uint32_t* data, size_t begin, size_t end,
+                          const uint8_t* slotOf, uint32_t* hist) {
+    auto add = [&](uint32_t v) {
+        const uint8_t slot = slotOf[v >> RADIX_BITS];
+        if (slot != NO_SLOT) {
+            ++hist[slot * RADIX_BUCKETS + (v & RADIX_MASK)];
+        }
+    };
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        const uint8_t all = slotOf[data[i] >> RADIX_BITS] & slotOf[data[i + 1] >> RADIX_BITS] &
+                            slotOf[data[i + 2] >> RADIX_BITS] & slotOf[data[i + 3] >> RADIX_BITS];
+        if ((all & 0x80) == 0) {
+            add(data[i]);
+            add(data[i + 1]);
+            add(data[i + 2]);
+            add(data[i + 3]);
+        }
+    }
+    for (; i < end; ++i) {
+        add(data[i]);
+    }
+}
+
+// Run `body(begin, end, histogram)` on `threads` contiguous slices of
+// [0, n) in parallel, each thread counting into its own `lanes` 32-bit
+// histograms. Every HIST_FLUSH_VALUES values, and at the end of its slice, a
+// thread adds its counts into the shared 64-bit result and starts over, so no
+// counter wraps however large n is. Lane l is folded into output slice
+// l % slices, so slices = 1 collapses every lane into one histogram.
+template <typename Body>
+static std::vector<uint64_t> parallelHistogram(size_t n, unsigned threads, size_t lanes,
+                                               size_t slices, Body body) {
+    std::vector<uint64_t> merged(slices * RADIX_BUCKETS, 0);
+    std::mutex mergeLock;
+    auto worker = [&](size_t begin, size_t end) {
+        std::vector<uint32_t> hist(lanes * RADIX_BUCKETS);
+        for (size_t first = begin; first < end; first += HIST_FLUSH_VALUES) {
+            body(first, std::min(end, first + HIST_FLUSH_VALUES), hist.data());
+            std::lock_guard<std::mutex> lock(mergeLock);
+            for (size_t l = 0; l < lanes; ++l) {
+                uint64_t* out = merged.data() + (l % slices) * RADIX_BUCKETS;
+                uint32_t* in = hist.data() + l * RADIX_BUCKETS;
+                for (size_t b = 0; b < RADIX_BUCKETS; ++b) {
+                    out[b] += in[b];
+                    in[b] = 0;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    const size_t slice = (n + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; ++t) {
+        size_t begin = std::min(n, t * slice);
+        size_t end   = std::min(n, begin + slice);
+        if (t + 1 == threads) {
+            worker(begin, end); // the calling thread takes the last slice
+        } else {
+            workers.emplace_back(worker, begin, end);
+        }
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    return merged;
+}
+
+// Multi-rank radix select. Returns the ranks[i]-th smallest value of
+// data[0..n) for every i, without writing to the input.
+//
+// One pass histograms the high 16 bits for all ranks at once; afterwards only
+// the distinct buckets that contain a requested rank are refined, all of them
+// (up to MAX_PASS_BUCKETS) in one more pass. Up to HIST_LANES buckets are
+// picked out with compares; beyond that a 64K-entry prefix-to-slot table
+// routes each value to its bucket's histogram. Any set of percentiles from
+// p1..p99 therefore costs the same two passes as a single median. Extra
+// memory per thread is 256 KB for each of max(HIST_LANES, buckets)
+// histograms, plus the merged histograms.
+static std::vector<uint32_t> radixSelect(const uint32_t* data, size_t n,
+                                         const std::vector<uint64_t>& ranks, unsigned threads) {
+    auto high = parallelHistogram(n, threads, HIST_LANES, 1,
+        [data](size_t begin, size_t end, uint32_t* hist) {
+            countHigh(data, begin, end, hist);
+        });
+
+    std::vector<uint32_t> prefix(ranks.size());
+    std::vector<uint64_t> within(ranks.size());
+    for (size_t r = 0; r < ranks.size(); ++r) {
+        within[r] = ranks[r];
+        prefix[r] = findBucket(high.data(), within[r]);
+    }
+
+    std::vector<uint32_t> buckets(prefix);
+    std::sort(buckets.begin(), buckets.end());
+    buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+    std::vector<uint32_t> result(ranks.size());
+    for (size_t g = 0; g < buckets.size(); g += MAX_PASS_BUCKETS) {
+        const uint32_t* group = buckets.data() + g;
+        const size_t count = std::min(MAX_PASS_BUCKETS, buckets.size() - g);
+        std::vector<uint64_t> low;
+        if (count <= HIST_LANES) {
+            low = parallelHistogram(n, threads, HIST_LANES, count,
+                [data, group, count](size_t begin, size_t end, uint32_t* hist) {
+                    countLow(data, begin, end, group, count, hist);
+                });
+        } else {
+            std::vector<uint8_t> slotOf(RADIX_BUCKETS, NO_SLOT);
+            for (size_t b = 0; b < count; ++b) {
+                slotOf[group[b]] = static_cast<uint8_t>(b);
+            }
+            const uint8_t* table = slotOf.data();
+            low = parallelHistogram(n, threads, count, count,
+                [data, table](size_t begin, size_t end, uint32_t* hist) {
+                    countLowTable(data, begin, end, table, hist);
+                });
+        }
+
+        for (size_t r = 0; r < ranks.size(); ++r) {
+            const uint32_t* hit = std::find(group, group + count, prefix[r]);
+            if (hit == group + count) {
+                continue;
+            }
+            uint64_t k = within[r];
+            const uint32_t suffix = findBucket(low.data() + (hit - group) * RADIX_BUCKETS, k);
+            result[r] = (prefix[r] << RADIX_BITS) | suffix;
+        }
+    }
+    return result;
+}
+
+// Rank answered for quantile q over n values: floor(q * n), clamped to the
+// last element, so q = 0.5 is the element at index N/2.
+static uint64_t quantileRank(double q, uint64_t n) {
+    return std::min<uint64_t>(static_cast<uint64_t>(q * static_cast<double>(n)), n - 1);
+}
+
+// ---------------------------------------------------------------------------
+// KllSketch: mergeable streaming quantile sketch (Karnin, Lang, Liberty).
+//
+// Values live in a stack of compactors. Level h holds items of weight 2^h;
+// when the sketch exceeds its capacity, the lowest full level is sorted and
+// every other item (random offset) is promoted to the level above. Level
+// capacities shrink geometrically by 2/3 from the top, so total memory is
+// about 3k values regardless of the stream length, and the normalized rank
+// error is roughly 2/k with high probability.
+//
+// Levels whose capacity would drop below MIN_CAPACITY are replaced by a
+// sampler: raw values are reservoir-sampled one per block of 2^s and only
+// the survivor enters level s. That keeps the per-value cost at a couple of
+// nanoseconds instead of sorting every value through the bottom levels.
+// ---------------------------------------------------------------------------
+class KllSketch {
+public:
+    explicit KllSketch(uint32_t k) : k_(std::max<uint32_t>(k, MIN_CAPACITY)), levels_(1) {
+        updateCapacities();
+    }
+
+    // Build a sketch whose normalized rank error is about `eps`.
+    static KllSketch withError(double eps) {
+        double k = std::ceil(2.0 / eps);
+        return KllSketch(static_cast<uint32_t>(std::min(k, 65536.0)));
+    }
+
+    void update(uint32_t v) {
+        ++n_;
+        sample(v, 1);
+    }
+
+    // Fold another sketch (e.g. built from another stream) into this one.
+    void merge(const KllSketch& other) {
+        n_ += other.n_;
+        for (size_t h = 0; h < other.levels_.size(); ++h) {
+            for (uint32_t v : other.levels_[h]) {
+                if (h >= shift_) {
+                    insert(v, h);
+                } else {
+                    sample(v, uint64_t(1) << h);
+                }
+            }
+        }
+        if (other.seen_ != 0) {
+            sample(other.candidate_, other.seen_);
+        }
+    }
+
+    uint64_t count() const { return n_; }
+
+    // Approximate value of rank quantileRank(q, n), matching the exact path.
+    uint32_t quantile(double q) const {
+        std::vector<std::pair<uint32_t, uint64_t>> items;
+        items.reserve(size_ + 1);
+        for (size_t h = shift_; h < levels_.size(); ++h) {
+            for (uint32_t v : levels_[h]) {
+                items.emplace_back(v, uint64_t(1) << h);
+            }
+        }
+        if (seen_ != 0) {
+            items.emplace_back(candidate_, seen_);
+        }
+        if (items.empty()) {
+            return 0;
+        }
+        std::sort(items.begin(), items.end());
+
+        const uint64_t rank = quantileRank(q, n_);
+        uint64_t seen = 0;
+        for (const auto& [v, w] : items) {
+            seen += w;
+            if (seen > rank) {
+                return v;
+            }
+        }
+        return items.back().first;
+    }
+
+private:
+    static constexpr uint32_t MIN_CAPACITY = 8;
+
+    // Weighted reservoir sampling into the current block of 2^shift_ units.
+    // An item heavier than what is left of the block spills into the next.
+    void sample(uint32_t v, uint64_t w) {
+        while (w != 0) {
+            const uint64_t block = uint64_t(1) << shift_;
+            const uint64_t take = std::min(w, block - seen_);
+            seen_ += take;
+            if (static_cast<uint64_t>((static_cast<unsigned __int128>(nextRandom()) * seen_) >> 64) < take) {
+                candidate_ = v;
+            }
+            w -= take;
+            if (seen_ == block) {
+                seen_ = 0;
+                insert(candidate_, shift_);
+            }
+        }
+    }
+
+    void insert(uint32_t v, size_t h) {
+        while (h >= levels_.size()) {
+            levels_.emplace_back();
+            updateCapacities();
+        }
+        levels_[h].push_back(v);
+        if (++size_ > capacity_) {
+            compress();
+        }
+    }
+
+    // Level capacities only change when a level is added, so cache them.
+    void updateCapacities() {
+        caps_.assign(levels_.size(), 0);
+        capacity_ = 0;
+        for (size_t h = shift_; h < levels_.size(); ++h) {
+            caps_[h] = std::max<uint32_t>(MIN_CAPACITY, rawCapacity(h));
+            capacity_ += caps_[h];
+        }
+    }
+
+    uint32_t rawCapacity(size_t h) const {
+        const size_t depth = levels_.size() - 1 - h;
+        return static_cast<uint32_t>(std::ceil(k_ * std::pow(2.0 / 3.0, static_cast<double>(depth))));
+    }
+
+    // Sort level h and promote every other item (random offset) to h + 1.
+    // Returns the unpaired item, if any, through `leftover`.
+    bool compactLevel(size_t h, uint32_t& leftover) {
+        auto& cur = levels_[h];
+        auto& up  = levels_[h + 1];
+        std::sort(cur.begin(), cur.end());
+
+        const bool odd = cur.size() % 2 != 0;
+        if (odd) {
+            leftover = cur.back();
+            cur.pop_back();
+        }
+        for (size_t i = nextRandom() & 1; i < cur.size(); i += 2) {
+            up.push_back(cur[i]);
+        }
+        size_ -= cur.size() / 2 + (odd ? 1 : 0);
+        cur.clear();
+        return odd;
+    }
+
+    // Compact the lowest level that is at or above its capacity, then retire
+    // bottom levels into the sampler once they would be smaller than
+    // MIN_CAPACITY.
+    void compress() {
+        for (size_t h = shift_; h < levels_.size(); ++h) {
+            if (levels_[h].size() < caps_[h]) {
+                continue;
+            }
+            if (h + 1 == levels_.size()) {
+                levels_.emplace_back();
+            }
+            uint32_t leftover = 0;
+            if (compactLevel(h, leftover)) {
+                levels_[h].push_back(leftover);
+                ++size_;
+            }
+            break;
+        }
+
+        while (levels_.size() - shift_ > 1 && rawCapacity(shift_) < MIN_CAPACITY) {
+            uint32_t leftover = 0;
+            const bool odd = compactLevel(shift_, leftover);
+            ++shift_;
+            if (odd) {
+                // The new block is twice as large, so the partial block plus
+                // this item of weight 2^(shift_-1) cannot complete it.
+                sample(leftover, uint64_t(1) << (shift_ - 1));
+            }
+        }
+        updateCapacities();
+    }
+
+    uint64_t nextRandom() {
+        // xorshift64: cheap, and good enough for sampling decisions.
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 7;
+        rng_ ^= rng_ << 17;
+        return rng_;
+    }
+
+    uint32_t k_;
+    uint64_t n_ = 0;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    size_t shift_ = 0;        // sampler block is 2^shift_ raw values
+    uint64_t seen_ = 0;       // units consumed in the current sampler block
+    uint32_t candidate_ = 0;  // reservoir pick for the current sampler block
+    uint64_t rng_ = 0x9E3779B97F4A7C15ull;
+    std::vector<std::vector<uint32_t>> levels_;
+    std::vector<uint32_t> caps_;
+};
+
+// Feed every little-endian uint32_t from `fd` into the sketch, reading in
+// fixed-size chunks. Works on pipes as well as regular files.
+static bool streamInto(int fd, KllSketch& sketch) {
+    static constexpr size_t CHUNK_BYTES = 64 * 1024;
+    alignas(64) static unsigned char buf[CHUNK_BYTES];
+    size_t carry = 0; // bytes of a partial value left over from the last read
+
+    for (;;) {
+        ssize_t r = ::read(fd, buf + carry, CHUNK_BYTES - carry);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("read");
+            return false;
+        }
+        if (r == 0) {
+            break;
+        }
+        size_t avail = carry + static_cast<size_t>(r);
+        size_t whole = avail / sizeof(uint32_t);
+        for (size_t i = 0; i < whole; ++i) {
+            uint32_t v;
+            std::memcpy(&v, buf + i * sizeof(uint32_t), sizeof(v));
+            sketch.update(v);
+        }
+        carry = avail - whole * sizeof(uint32_t);
+        std::memmove(buf, buf + whole * sizeof(uint32_t), carry);
+    }
+    if (carry != 0) {
+        std::cerr << "Warning: ignoring " << carry << " trailing byte(s).\n";
+    }
+    return true;
+}
+
+// Parse a comma-separated list of quantiles. Each entry is either a fraction
+// ("0.9") or a percentile ("p90").
+static bool parseQuantiles(const char* arg, std::vector<double>& out) {
+    const char* p = arg;
+    while (*p) {
+        bool percent = (*p == 'p' || *p == 'P');
+        if (percent) {
+            ++p;
+        }
+        char* end = nullptr;
+        double q = std::strtod(p, &end);
+        if (end == p) {
+            return false;
+        }
+        if (percent) {
+            q /= 100.0;
+        }
+        if (q < 0.0 || q > 1.0) {
+            return false;
+        }
+        out.push_back(q);
+        p = end;
+        if (*p == ',') {
+            ++p;
+        } else if (*p != '\0') {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+// Parse a comma-separated list of 0-based ranks.
+static bool parseRanks(const char* arg, std::vector<uint64_t>& out) {
+    const char* p = arg;
+    while (*p) {
+        char* end = nullptr;
+        unsigned long long r = std::strtoull(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        out.push_back(r);
+        p = end;
+        if (*p == ',') {
+            ++p;
+        } else if (*p != '\0') {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+int main(int argc, char** argv) {
+    // "--threads T" runs the radix selection passes on T threads
+    // (T = 0 means one thread per hardware thread; default is 1).
+    //
+    // "--stream" reads stdin in chunks (pipes are fine) into a KLL sketch
+    // and answers approximately; "--eps E" sets its target rank error and
+    // "--quantiles LIST" (e.g. "p50,p90,p99") picks what to report.
+    //
+    // Without "--stream" the answers are exact: "--quantiles LIST" or
+    // "--ranks LIST" (0-based, e.g. "0,49999999") select several order
+    // statistics in one multi-select run. One value is printed per line,
+    // in the order requested.
+    bool stream = false;
+    unsigned threads = 1;
+    double eps = 0.01;
+    std::vector<double> quantiles;
+    std::vector<uint64_t> ranks;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (std::strcmp(argv[i], "--eps") == 0 && i + 1 < argc) {
+            eps = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--quantiles") == 0 && i + 1 < argc &&
+                   parseQuantiles(argv[i + 1], quantiles)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--ranks") == 0 && i + 1 < argc &&
+                   parseRanks(argv[i + 1], ranks)) {
+            ++i;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--threads T] [--quantiles LIST | --ranks LIST]\n"
+                      << "       " << argv[0]
+                      << " --stream [--eps E] [--quantiles LIST]\n";
+            return 1;
+        }
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    if (!quantiles.empty() && !ranks.empty()) {
+        std::cerr << "Error: --quantiles and --ranks are mutually exclusive.\n";
+        return 1;
+    }
+
+    if (stream) {
+        if (!ranks.empty()) {
+            std::cerr << "Error: --ranks requires exact mode.\n";
+            return 1;
+        }
+        if (!(eps > 0.0 && eps < 1.0)) {
+            std::cerr << "Error: --eps must be in (0, 1).\n";
+            return 1;
+        }
+        if (quantiles.empty()) {
+            quantiles.push_back(0.5);
+        }
+        KllSketch sketch = KllSketch::withError(eps);
+        if (!streamInto(STDIN_FILENO, sketch)) {
+            return 1;
+        }
+        if (sketch.count() == 0) {
+            std::cerr << "Error: no input values.\n";
+            return 1;
+        }
+        for (double q : quantiles) {
+            std::cout << sketch.quantile(q) << "\n";
+        }
+        return 0;
+    }
 
-int main() {
     // We will mmap standard input (file descriptor = 0).
     struct stat st;
     if (fstat(STDIN_FILENO, &st) < 0) {
         perror("fstat");
         return 1;
     }
+    if (!S_ISREG(st.st_mode)) {
+        std::cerr << "Error: stdin is not a regular file; use --stream for pipes.\n";
+        return 1;
+    }
 
-    // Optional sanity check: ensure the file is at least large enough
-    // to contain N 32-bit integers (400 million bytes).
-    if (static_cast<size_t>(st.st_size) < N * sizeof(uint32_t)) {
-        std::cerr << "Error: Not enough data for " << N 
-                  << " uint32_t values.\n";
+    // The input is a raw array of little-endian uint32_t; N follows from
+    // the file size.
+    const size_t n = static_cast<size_t>(st.st_size) / sizeof(uint32_t);
+    if (n == 0) {
+        std::cerr << "Error: no input values.\n";
         return 1;
     }
+    if (static_cast<size_t>(st.st_size) % sizeof(uint32_t) != 0) {
+        std::cerr << "Warning: ignoring " << st.st_size % sizeof(uint32_t)
+                  << " trailing byte(s).\n";
+    }
 
-    // Map the entire input file into memory (read+write in private copy).
-    // MAP_PRIVATE allows us to do in-place partitioning without affecting
-    // the underlying data. On Linux, PROT_READ|PROT_WRITE is permissible here
-    // for an in-place nth_element if needed. 
+    // Default query: the median, i.e. the element at index N/2 after sorting.
+    for (double q : quantiles) {
+        ranks.push_back(quantileRank(q, n));
+    }
+    if (ranks.empty()) {
+        ranks.push_back(n / 2);
+    }
+    for (uint64_t r : ranks) {
+        if (r >= n) {
+            std::cerr << "Error: rank " << r << " out of range for " << n << " values.\n";
+            return 1;
+        }
+    }
+
+    // Map the entire input file read-only. Selection never writes to it, so
+    // no page is copied and RSS stays at the page cache footprint plus a few
+    // MB of histograms.
     void* addr = mmap(nullptr,
                       st.st_size,
-                      PROT_READ | PROT_WRITE,
+                      PROT_READ,
                       MAP_PRIVATE,
                       STDIN_FILENO,
                       0);
@@ -39,19 +695,18 @@ int main() {
         perror("mmap");
         return 1;
     }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
 
     // Treat this mapped region as an array of uint32_t.
-    auto* dataPtr = static_cast<uint32_t*>(addr);
-
-    // Use nth_element to place the median element at index N/2.
-    // This is typically O(N) on average, much faster than full sorting.
-    std::nth_element(dataPtr, dataPtr + (N / 2), dataPtr + N);
+    const auto* dataPtr = static_cast<const uint32_t*>(addr);
 
-    // The median is now at position N/2.
-    uint32_t medianVal = dataPtr[N / 2];
+    // All requested order statistics come out of the same selection passes.
+    std::vector<uint32_t> values = radixSelect(dataPtr, n, ranks, threads);
 
-    // Print it
-    std::cout << medianVal << "\n";
+    // Print them
+    for (uint32_t v : values) {
+        std::cout << v << "\n";
+    }
 
     // Unmap the memory before exiting.
     munmap(addr, st.st_size);
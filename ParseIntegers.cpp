@@ -4,9 +4,18 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <cassert>
+#include <thread>
+#include <vector>
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22 // Linux 5.14+; older kernels reject it harmlessly
+#endif
 
 // Helper function: convert ASCII digits [start, end) to a 64-bit number.
 // We assume that the substring contains only characters '0'..'9'.
@@ -18,36 +27,218 @@ static inline uint64_t parseNumber(const char* start, const char* end) {
     return val;
 }
 
-int main() {
-    // Get size of stdin
-    struct stat st;
-    if (fstat(STDIN_FILENO, &st) < 0) {
-        std::perror("fstat");
-        return 1;
+// Shuffle masks for parseDigits16: entry L moves the L digits loaded at the
+// front of a register to its last L bytes and zeroes the rest (0x80 lanes).
+struct AlignMasks {
+    alignas(16) uint8_t mask[17][16];
+    AlignMasks() {
+        for (int len = 0; len <= 16; ++len) {
+            for (int i = 0; i < 16; ++i) {
+                int src = i - (16 - len);
+                mask[len][i] = src >= 0 ? static_cast<uint8_t>(src) : 0x80;
+            }
+        }
     }
-    off_t dataSize = st.st_size;
-    if (dataSize == 0) {
-        // Nothing to read
-        std::cout << 0 << "\n";
-        return 0;
+};
+static const AlignMasks ALIGN_MASKS;
+
+// SIMD version of parseNumber for up to 16 digits. Reads 16 bytes at start,
+// so the caller must guarantee they are mapped.
+//   1. subtract '0' and right-align the digits (leading lanes become 0)
+//   2. pmaddubsw with 10,1,...  -> 8 two-digit values
+//   3. pmaddwd   with 100,1,... -> 4 four-digit values
+//   4. packusdw + pmaddwd with 10000,1,... -> 2 eight-digit values
+//   5. high * 10^8 + low
+static inline uint64_t reduceDigits16(__m128i digits, size_t len) {
+    __m128i chunk = _mm_shuffle_epi8(digits, _mm_load_si128(reinterpret_cast<const __m128i*>(ALIGN_MASKS.mask[len])));
+
+    const __m128i mul10    = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+    const __m128i mul100   = _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1);
+    const __m128i mul10000 = _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1);
+    chunk = _mm_maddubs_epi16(chunk, mul10);
+    chunk = _mm_madd_epi16(chunk, mul100);
+    chunk = _mm_packus_epi32(chunk, chunk);
+    chunk = _mm_madd_epi16(chunk, mul10000);
+
+    uint64_t halves = static_cast<uint64_t>(_mm_cvtsi128_si64(chunk));
+    return (halves & 0xFFFFFFFF) * 100000000ULL + (halves >> 32);
+}
+
+static inline uint64_t parseDigits16(const char* start, size_t len) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(start));
+    return reduceDigits16(_mm_sub_epi8(chunk, _mm_set1_epi8('0')), len);
+}
+
+// Parse the line [start, end). Lines of up to 16 digits take one SIMD step;
+// longer ones parse their leading digits with the scalar loop and the last
+// 16 with SIMD, which wraps exactly like the scalar loop would (mod 2^64).
+// Lines too close to the end of the mapping to load 16 bytes fall back to
+// the scalar loop.
+static inline uint64_t parseLine(const char* start, const char* end, const char* limit) {
+    size_t len = static_cast<size_t>(end - start);
+    if (__builtin_expect(end + 16 > limit, 0)) {
+        return parseNumber(start, end);
+    }
+    if (len <= 16) {
+        return parseDigits16(start, len);
     }
+    return parseNumber(start, end - 16) * 10000000000000000ULL + parseDigits16(end - 16, 16);
+}
 
-    // MMAP stdin
-    char* data = static_cast<char*>(
-        mmap(nullptr, dataSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, STDIN_FILENO, 0));
-    if (data == MAP_FAILED) {
-        std::perror("mmap");
-        return 1;
+// ---------------------------------------------------------------------------
+// Validated mode (--validate). A line is
+//     [spaces] [+|-] digits [spaces] [\r]
+// or blank. Negative values are subtracted (the sum still wraps mod 2^64 and
+// is printed as a signed 64-bit value); anything else is a bad line that is
+// counted, reported by byte offset and left out of the sum.
+//
+// The fast path strips a trailing '\r' and a leading sign with two scalar
+// compares and classifies the remaining bytes with a vector compare. Up to
+// 16 digits are classified and converted from the same 16-byte load; up to
+// 32 are classified with one 32-byte compare and handed to parseLine. Lines
+// with spaces, more than 32 digits or bad bytes go to the scalar checker.
+// ---------------------------------------------------------------------------
+
+// True if [d, d + n), 1 <= n <= 32, holds only '0'..'9'. Loads 32 bytes at d.
+static inline bool allDigits32(const char* d, size_t n) {
+    __m256i v = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(d)),
+                                _mm256_set1_epi8('0'));
+    // Unsigned v <= 9  <=>  min(v, 9) == v
+    __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(9)), v);
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(isDigit));
+    uint32_t want = n == 32 ? ~0u : (1u << n) - 1;
+    return (mask & want) == want;
+}
+
+// parseDigits16 that first checks [d, d + n), 1 <= n <= 16, is all digits.
+static inline bool parseDigits16Checked(const char* d, size_t n, uint64_t& value) {
+    __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(d)), _mm_set1_epi8('0'));
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(9)), v);
+    uint32_t want = (1u << n) - 1;
+    if ((static_cast<uint32_t>(_mm_movemask_epi8(isDigit)) & want) != want) {
+        return false;
     }
+    value = reduceDigits16(v, n);
+    return true;
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Scalar checker for everything the fast path does not take.
+static bool parseLineChecked(const char* start, const char* end, uint64_t& value) {
+    while (start < end && isBlank(*start)) {
+        ++start;
+    }
+    if (end > start && end[-1] == '\r') {
+        --end;
+    }
+    while (end > start && isBlank(end[-1])) {
+        --end;
+    }
+    value = 0;
+    if (start == end) {
+        return true; // blank line
+    }
+    const bool negative = *start == '-';
+    if (*start == '-' || *start == '+') {
+        ++start;
+    }
+    if (start == end) {
+        return false; // lone sign
+    }
+    for (const char* p = start; p < end; ++p) {
+        if (static_cast<unsigned char>(*p - '0') > 9) {
+            return false;
+        }
+    }
+    value = parseNumber(start, end);
+    if (negative) {
+        value = 0 - value;
+    }
+    return true;
+}
+
+static inline bool parseLineValidated(const char* start, const char* end, const char* limit,
+                                      uint64_t& value) {
+    const char* d = start;
+    const char* e = end;
+    if (e > d && e[-1] == '\r') {
+        --e;
+    }
+    const bool negative = d < e && *d == '-';
+    if (d < e && (*d == '-' || *d == '+')) {
+        ++d;
+    }
+    const size_t n = static_cast<size_t>(e - d);
+    if (d + 32 <= limit) {
+        bool ok;
+        if (n - 1 < 16) {
+            ok = parseDigits16Checked(d, n, value);
+        } else if (n - 1 < 32 && allDigits32(d, n)) {
+            value = parseLine(d, e, limit);
+            ok = true;
+        } else {
+            ok = false;
+        }
+        if (ok) {
+            if (negative) {
+                value = 0 - value;
+            }
+            return true;
+        }
+    }
+    return parseLineChecked(start, end, value);
+}
+
+// Which per-line parser sumLines uses.
+enum class Parser { Scalar, Simd, Validated };
+
+// Result of summing a range: the wrapped sum, plus (validated mode only) the
+// number of bad lines and the starts of the first few of them.
+static const size_t MAX_REPORTED_BAD_LINES = 10;
+
+struct LineSums {
+    uint64_t sum = 0;
+    uint64_t badLines = 0;
+    std::vector<const char*> badStarts;
+
+    void noteBadLine(const char* start) {
+        if (badLines++ < MAX_REPORTED_BAD_LINES) {
+            badStarts.push_back(start);
+        }
+    }
+};
+
+// Sum the newline-separated numbers in [begin, end). A final line without a
+// trailing newline counts too. 'P' picks the per-line parser; 'limit' is the
+// end of the mapping, which bounds the SIMD parsers' wide loads.
+template <Parser P>
+static LineSums sumLines(const char* begin, const char* end, const char* limit) {
+    LineSums result;
 
     // We will accumulate the sum in a 64-bit integer (ignore overflow if it happens).
     // The problem statement says "In case of an integer overflow, just ignore it."
     // So we do not do any special handling beyond using a 64-bit type.
     uint64_t totalSum = 0;
 
+    auto parse = [limit, &result](const char* s, const char* e) -> uint64_t {
+        if (P == Parser::Scalar) {
+            return parseNumber(s, e);
+        }
+        if (P == Parser::Simd) {
+            return parseLine(s, e, limit);
+        }
+        uint64_t value;
+        if (!parseLineValidated(s, e, limit, value)) {
+            result.noteBadLine(s);
+        }
+        return value;
+    };
+
     // Pointers for parsing
-    const char* ptr = data;
-    const char* end = data + dataSize;
+    const char* ptr = begin;
 
     // AVX2 compare target for '\n'
     const __m256i newlineVec = _mm256_set1_epi8('\n');
@@ -66,35 +257,28 @@ int main() {
         // Create a bitmask where each byte is 1 if comparison matched else 0
         uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(cmp));
 
-        if (mask == 0) {
-            // No newline in these 32 bytes, continue
-            ptr += 32;
-        } else {
-            // At least one newline in this block
-            // We’ll find each newline's position.  Each set bit in 'mask'
-            // corresponds to a newline.  We handle them in ascending order.
-            while (mask != 0) {
-                // Get position of the rightmost (lowest index) set bit
-                // _tzcnt_u32 returns the index of the trailing set bit
-                unsigned pos = __builtin_ctz(mask);
-                // parse the integer from lineStart..(ptr+pos)
-                totalSum += parseNumber(lineStart, ptr + pos);
-                // skip the newline
-                lineStart = ptr + pos + 1;
-
-                // Clear that bit
-                mask &= (mask - 1);
-            }
-            // Advance pointer past the 32 bytes we just scanned
-            ptr += 32;
+        // Each set bit in 'mask' corresponds to a newline; handle them in
+        // ascending order.
+        while (mask != 0) {
+            // Get position of the rightmost (lowest index) set bit
+            unsigned pos = __builtin_ctz(mask);
+            // parse the integer from lineStart..(ptr+pos)
+            totalSum += parse(lineStart, ptr + pos);
+            // skip the newline
+            lineStart = ptr + pos + 1;
+
+            // Clear that bit
+            mask &= (mask - 1);
         }
+        // Advance pointer past the 32 bytes we just scanned
+        ptr += 32;
     }
 
     // Now handle the remainder (less than 32 bytes) with a simple scalar loop
     while (ptr < end) {
         if (*ptr == '\n') {
             // parse the line we've collected so far
-            totalSum += parseNumber(lineStart, ptr);
+            totalSum += parse(lineStart, ptr);
             lineStart = ptr + 1;
         }
         ++ptr;
@@ -102,13 +286,143 @@ int main() {
 
     // If the last line did not end with a newline, parse it
     if (lineStart < end) {
-        totalSum += parseNumber(lineStart, end);
+        totalSum += parse(lineStart, end);
+    }
+    result.sum = totalSum;
+    return result;
+}
+
+// Parallel driver: cut [data, end) into one equal byte range per thread,
+// move every cut forward past the next '\n' so no line is split, and sum the
+// pieces concurrently. The 64-bit sum wraps, and wrapping addition is
+// associative, so the total matches the sequential result bit for bit; bad
+// lines are merged in input order.
+// The mapping is not prefaulted up front; each worker populates its own
+// range with MADV_POPULATE_READ so page-table setup runs on all threads.
+template <Parser P>
+static LineSums parallelSumLines(const char* data, const char* end, unsigned threads) {
+    const size_t size = static_cast<size_t>(end - data);
+    std::vector<const char*> cuts(threads + 1, end);
+    cuts[0] = data;
+    for (unsigned t = 1; t < threads; ++t) {
+        const char* guess = std::max(data + size / threads * t, cuts[t - 1]);
+        const char* nl = static_cast<const char*>(std::memchr(guess, '\n', end - guess));
+        cuts[t] = nl ? nl + 1 : end;
+    }
+
+    const uintptr_t pageMask = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE)) - 1;
+    std::vector<LineSums> partial(threads);
+    auto worker = [&](unsigned t) {
+        const char* begin = cuts[t];
+        if (begin == cuts[t + 1]) {
+            return;
+        }
+        char* page = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(begin) & ~pageMask);
+        madvise(page, cuts[t + 1] - page, MADV_POPULATE_READ);
+        partial[t] = sumLines<P>(begin, cuts[t + 1], end);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0); // the calling thread works too
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    LineSums total;
+    for (const LineSums& p : partial) {
+        total.sum += p.sum;
+        for (const char* bad : p.badStarts) {
+            if (total.badStarts.size() < MAX_REPORTED_BAD_LINES) {
+                total.badStarts.push_back(bad);
+            }
+        }
+        total.badLines += p.badLines;
+    }
+    return total;
+}
+
+template <Parser P>
+static LineSums sumInput(const char* data, const char* end, unsigned threads) {
+    return threads > 1 ? parallelSumLines<P>(data, end, threads) : sumLines<P>(data, end, end);
+}
+
+int main(int argc, char** argv) {
+    // "--kernel simd|scalar" picks the per-line parser (default simd).
+    // "--threads T" splits the input over T threads (0 = all hardware threads).
+    // "--validate" accepts signs, spaces and \r\n endings, skips and reports
+    // bad lines, prints a signed sum and exits with 2 if any line was bad.
+    bool simd = true;
+    bool validate = false;
+    unsigned threads = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "simd") != 0 && std::strcmp(name, "scalar") != 0) {
+                std::cerr << "Unknown kernel '" << name << "'\n";
+                return 1;
+            }
+            simd = std::strcmp(name, "simd") == 0;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--validate") == 0) {
+            validate = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--kernel simd|scalar] [--threads T] [--validate]\n";
+            return 1;
+        }
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Get size of stdin
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) < 0) {
+        std::perror("fstat");
+        return 1;
+    }
+    off_t dataSize = st.st_size;
+    if (dataSize == 0) {
+        // Nothing to read
+        std::cout << 0 << "\n";
+        return 0;
+    }
+
+    // MMAP stdin (in parallel mode the workers prefault their own ranges)
+    char* data = static_cast<char*>(
+        mmap(nullptr, dataSize, PROT_READ, MAP_PRIVATE | (threads > 1 ? 0 : MAP_POPULATE),
+             STDIN_FILENO, 0));
+    if (data == MAP_FAILED) {
+        std::perror("mmap");
+        return 1;
+    }
+
+    const char* end = data + dataSize;
+    LineSums result = validate ? sumInput<Parser::Validated>(data, end, threads)
+                    : simd     ? sumInput<Parser::Simd>(data, end, threads)
+                               : sumInput<Parser::Scalar>(data, end, threads);
+
+    for (const char* bad : result.badStarts) {
+        std::cerr << "bad line at byte offset " << (bad - data) << "\n";
+    }
+    if (result.badLines > result.badStarts.size()) {
+        std::cerr << "... " << (result.badLines - result.badStarts.size()) << " more\n";
+    }
+    if (result.badLines > 0) {
+        std::cerr << result.badLines << " bad line(s) skipped\n";
     }
 
     // Cleanup
     munmap(data, dataSize);
 
     // Output the result
-    std::cout << totalSum << "\n";
+    if (validate) {
+        std::cout << static_cast<int64_t>(result.sum) << "\n";
+        return result.badLines > 0 ? 2 : 0;
+    }
+    std::cout << result.sum << "\n";
     return 0;
 }
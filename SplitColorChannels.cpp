@@ -0,0 +1,303 @@
+// SplitColorChannels.cpp
+//
+// Deinterleave a packed 8-bit image (RGB, BGR, RGBA or ARGB) read from stdin
+// into planar channels, in one pass over the input.
+//
+//   SplitColorChannels --layout rgba --channels b            > blue.raw
+//   SplitColorChannels --layout bgr  --channels rgb --out img   (img.r img.g img.b)
+//
+// A single requested channel goes to stdout unless --out is given; several
+// channels need --out PREFIX and are written to PREFIX.<channel>.
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <immintrin.h>
+
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#pragma GCC target("avx2")
+#endif
+
+// Channel indices used for plane arrays and layout offsets.
+enum Channel { R = 0, G = 1, B = 2, A = 3, NUM_CHANNELS = 4 };
+static const char CHANNEL_NAMES[NUM_CHANNELS] = {'r', 'g', 'b', 'a'};
+
+enum class Layout { RGB, BGR, RGBA, ARGB };
+
+// Per-layout bytes per pixel and byte offset of each channel (-1 if absent).
+template <Layout L> struct LayoutTraits;
+template <> struct LayoutTraits<Layout::RGB>  { static constexpr int bpp = 3; static constexpr int offset[4] = {0, 1, 2, -1}; };
+template <> struct LayoutTraits<Layout::BGR>  { static constexpr int bpp = 3; static constexpr int offset[4] = {2, 1, 0, -1}; };
+template <> struct LayoutTraits<Layout::RGBA> { static constexpr int bpp = 4; static constexpr int offset[4] = {0, 1, 2, 3}; };
+template <> struct LayoutTraits<Layout::ARGB> { static constexpr int bpp = 4; static constexpr int offset[4] = {1, 2, 3, 0}; };
+
+// pshufb masks that gather byte `offset` of each of 16 three-byte pixels out
+// of the three 16-byte pieces of a 48-byte block; one mask per piece.
+struct Packed3Masks {
+    alignas(16) char m[3][16];
+    constexpr explicit Packed3Masks(int offset) : m{} {
+        for (int j = 0; j < 16; ++j) {
+            const int idx = 3 * j + offset;
+            for (int k = 0; k < 3; ++k) {
+                m[k][j] = (idx / 16 == k) ? static_cast<char>(idx % 16) : static_cast<char>(0x80);
+            }
+        }
+    }
+};
+static constexpr Packed3Masks PACKED3_MASKS[3] = {Packed3Masks(0), Packed3Masks(1), Packed3Masks(2)};
+
+// Two unaligned 16-byte loads into the low and high lanes of one register.
+static inline __m256i loadLanes(const uint8_t* lo, const uint8_t* hi) {
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo));
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(l), h, 1);
+}
+
+static inline __m256i broadcastMask(const char* m) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(m)));
+}
+
+// Split in[0, n * bpp) into planes[c][0, n) for every non-null planes[c].
+// The layout is a template parameter, so channel offsets, shuffle masks and
+// the per-pixel stride are all compile-time constants in the vector loop.
+template <Layout L>
+static void splitPixels(const uint8_t* in, size_t n, uint8_t* const planes[NUM_CHANNELS]) {
+    using T = LayoutTraits<L>;
+    uint8_t* out[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; ++c) {
+        out[c] = (T::offset[c] >= 0) ? planes[c] : nullptr;
+    }
+
+    size_t i = 0;
+    if constexpr (T::bpp == 3) {
+        // 32 pixels (96 bytes) per iteration. Lane 0 holds bytes 0..47 and
+        // lane 1 bytes 48..95, so each channel is three in-lane shuffles.
+        __m256i mask[NUM_CHANNELS][3] = {};
+        for (int c = 0; c < NUM_CHANNELS; ++c) {
+            if (T::offset[c] >= 0) {
+                for (int k = 0; k < 3; ++k) {
+                    mask[c][k] = broadcastMask(PACKED3_MASKS[T::offset[c]].m[k]);
+                }
+            }
+        }
+        for (; i + 32 <= n; i += 32) {
+            const uint8_t* p = in + i * 3;
+            __m256i a = loadLanes(p +  0, p + 48);
+            __m256i b = loadLanes(p + 16, p + 64);
+            __m256i c = loadLanes(p + 32, p + 80);
+            for (int ch = 0; ch < NUM_CHANNELS; ++ch) {
+                if (!out[ch]) {
+                    continue;
+                }
+                __m256i v = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, mask[ch][0]),
+                                                            _mm256_shuffle_epi8(b, mask[ch][1])),
+                                            _mm256_shuffle_epi8(c, mask[ch][2]));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[ch] + i), v);
+            }
+        }
+    } else {
+        // 32 pixels (128 bytes) per iteration: a 4x4 byte transpose. pshufb
+        // groups each lane by byte position, permutevar8x32 turns every
+        // register into four 8-pixel runs, and 64/128-bit unpacks stitch the
+        // runs of four registers into one 32-byte plane per byte position.
+        const __m256i group = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                               0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (; i + 32 <= n; i += 32) {
+            const uint8_t* p = in + i * 4;
+            __m256i v[4];
+            for (int k = 0; k < 4; ++k) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * k));
+                v[k] = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(x, group), order);
+            }
+            __m256i t0 = _mm256_unpacklo_epi64(v[0], v[1]);
+            __m256i t1 = _mm256_unpackhi_epi64(v[0], v[1]);
+            __m256i t2 = _mm256_unpacklo_epi64(v[2], v[3]);
+            __m256i t3 = _mm256_unpackhi_epi64(v[2], v[3]);
+            __m256i pos[4] = {
+                _mm256_permute2x128_si256(t0, t2, 0x20),
+                _mm256_permute2x128_si256(t1, t3, 0x20),
+                _mm256_permute2x128_si256(t0, t2, 0x31),
+                _mm256_permute2x128_si256(t1, t3, 0x31),
+            };
+            for (int ch = 0; ch < NUM_CHANNELS; ++ch) {
+                if (out[ch]) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[ch] + i), pos[T::offset[ch]]);
+                }
+            }
+        }
+    }
+
+    // Leftover pixels.
+    for (; i < n; ++i) {
+        for (int ch = 0; ch < NUM_CHANNELS; ++ch) {
+            if (out[ch]) {
+                out[ch][i] = in[i * T::bpp + T::offset[ch]];
+            }
+        }
+    }
+}
+
+using SplitKernel = void (*)(const uint8_t*, size_t, uint8_t* const*);
+
+struct LayoutInfo {
+    const char* name;
+    int bpp;
+    const int* offset;
+    SplitKernel split;
+};
+
+static const LayoutInfo LAYOUTS[] = {
+    {"rgb",  3, LayoutTraits<Layout::RGB>::offset,  splitPixels<Layout::RGB>},
+    {"bgr",  3, LayoutTraits<Layout::BGR>::offset,  splitPixels<Layout::BGR>},
+    {"rgba", 4, LayoutTraits<Layout::RGBA>::offset, splitPixels<Layout::RGBA>},
+    {"argb", 4, LayoutTraits<Layout::ARGB>::offset, splitPixels<Layout::ARGB>},
+};
+
+// Write all of buf to fd, retrying on short writes.
+static bool writeAll(int fd, const uint8_t* buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = ::write(fd, buf, len);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += w;
+        len -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const LayoutInfo* layout = nullptr;
+    const char* channels = nullptr;
+    const char* outPrefix = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+            ++i;
+            for (const auto& l : LAYOUTS) {
+                if (std::strcmp(argv[i], l.name) == 0) {
+                    layout = &l;
+                }
+            }
+        } else if (std::strcmp(argv[i], "--channels") == 0 && i + 1 < argc) {
+            channels = argv[++i];
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPrefix = argv[++i];
+        } else {
+            layout = nullptr;
+            break;
+        }
+    }
+    if (channels && channels[std::strspn(channels, "rgba")] != '\0') {
+        layout = nullptr; // unknown channel letter
+    }
+    if (!layout) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --layout rgb|bgr|rgba|argb [--channels LIST] [--out PREFIX]\n";
+        return 1;
+    }
+
+    // Channel mask; default is every channel the layout has.
+    bool want[NUM_CHANNELS] = {};
+    int numWanted = 0;
+    for (int c = 0; c < NUM_CHANNELS; ++c) {
+        bool requested = channels ? std::strchr(channels, CHANNEL_NAMES[c]) != nullptr
+                                  : layout->offset[c] >= 0;
+        if (requested && layout->offset[c] < 0) {
+            std::cerr << "Layout " << layout->name << " has no '" << CHANNEL_NAMES[c] << "' channel\n";
+            return 1;
+        }
+        want[c] = requested;
+        numWanted += requested;
+    }
+    if (numWanted == 0 || (numWanted > 1 && !outPrefix)) {
+        std::cerr << "Request one channel for stdout, or use --out PREFIX\n";
+        return 1;
+    }
+
+    // Open one output per requested plane.
+    int fds[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; ++c) {
+        fds[c] = -1;
+        if (!want[c]) {
+            continue;
+        }
+        if (!outPrefix) {
+            fds[c] = STDOUT_FILENO;
+            continue;
+        }
+        std::string path = std::string(outPrefix) + "." + CHANNEL_NAMES[c];
+        fds[c] = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fds[c] < 0) {
+            perror(path.c_str());
+            return 1;
+        }
+    }
+
+    // The pixel count follows from the input size.
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) != 0) {
+        perror("fstat stdin");
+        return 1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        std::cerr << "stdin must be a regular file (it is mapped, not read)\n";
+        return 1;
+    }
+    const size_t inputSize = static_cast<size_t>(st.st_size);
+    const size_t numPixels = inputSize / layout->bpp;
+    if (inputSize % layout->bpp != 0) {
+        std::cerr << "Ignoring " << inputSize % layout->bpp << " trailing byte(s)\n";
+    }
+    if (numPixels == 0) {
+        return 0;
+    }
+
+    void* inPtr = mmap(nullptr, inputSize, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+    if (inPtr == MAP_FAILED) {
+        perror("mmap stdin");
+        return 1;
+    }
+    madvise(inPtr, inputSize, MADV_SEQUENTIAL);
+    const uint8_t* in = static_cast<const uint8_t*>(inPtr);
+
+    // Work in tiles small enough that a tile's planes stay in L2 until they
+    // are written out.
+    static const size_t TILE_PIXELS = 64 * 1024;
+    static uint8_t tileBuf[NUM_CHANNELS][TILE_PIXELS];
+    uint8_t* planes[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; ++c) {
+        planes[c] = want[c] ? tileBuf[c] : nullptr;
+    }
+
+    for (size_t first = 0; first < numPixels; first += TILE_PIXELS) {
+        const size_t n = std::min(TILE_PIXELS, numPixels - first);
+        layout->split(in + first * layout->bpp, n, planes);
+        for (int c = 0; c < NUM_CHANNELS; ++c) {
+            if (want[c] && !writeAll(fds[c], planes[c], n)) {
+                perror("write");
+                munmap(inPtr, inputSize);
+                return 1;
+            }
+        }
+    }
+
+    munmap(inPtr, inputSize);
+    for (int c = 0; c < NUM_CHANNELS; ++c) {
+        if (fds[c] > STDOUT_FILENO) {
+            close(fds[c]);
+        }
+    }
+    return 0;
+}
@@ -1,125 +1,691 @@
 #include <iostream>
-#include <queue>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cstdint>
+#include <cstdlib>
+#include <cstdio>
 #include <cstring>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <immintrin.h>
 
-static const size_t N = 100'000'000; // Number of 32-bit integers to read
-static const size_t K = 100;         // We want the sum of the top-100 greatest numbers
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22 // Linux 5.14+; older kernels reject it harmlessly
+#endif
 
-int main() {
-    // Try to open "/dev/stdin"
-    int fd = open("/dev/stdin", O_RDONLY);
+static const size_t DEFAULT_K = 100;         // We want the sum of the top-100 greatest numbers
 
-    // If that fails, fallback to fd=0 (stdin)
-    if (fd < 0) {
-        fd = 0; // File descriptor 0 is standard input
+// Mergeable top-K accumulator: a min-heap of at most k values whose root is
+// the smallest value kept. Merging two accumulators pushes one's values into
+// the other, so per-thread partial results combine into the exact global
+// answer (the sum of the k largest values, duplicates counted).
+class TopK {
+public:
+    explicit TopK(size_t k) : k_(k) { heap_.reserve(k); }
+
+    // Never true for k = 0, so min() is never read from an empty heap.
+    bool full() const { return k_ > 0 && heap_.size() >= k_; }
+
+    // Smallest kept value; only meaningful once full().
+    uint32_t min() const { return heap_.front(); }
+
+    void push(uint32_t val) {
+        if (heap_.size() < k_) {
+            heap_.push_back(val);
+            std::push_heap(heap_.begin(), heap_.end(), std::greater<uint32_t>());
+        } else if (k_ > 0 && val > heap_.front()) {
+            replaceMin(val);
+        }
+    }
+
+    // Replace the smallest kept value; requires full() and val > min().
+    // One sift-down from the root, half the work of pop_heap + push_heap.
+    void replaceMin(uint32_t val) {
+        const size_t n = heap_.size();
+        size_t i = 0;
+        for (size_t c; (c = 2 * i + 1) < n; i = c) {
+            if (c + 1 < n && heap_[c + 1] < heap_[c]) {
+                ++c;
+            }
+            if (heap_[c] >= val) {
+                break;
+            }
+            heap_[i] = heap_[c];
+        }
+        heap_[i] = val;
     }
 
-    // We know that there should be N * sizeof(uint32_t) bytes,
-    // but let's attempt an mmap. 
-    // In many environments, mmap of a pipe or certain STDIN streams may fail:
-    size_t totalBytes = N * sizeof(uint32_t);
+    void merge(const TopK& other) {
+        for (uint32_t val : other.heap_) {
+            push(val);
+        }
+    }
 
-    void* mmappedData = mmap(nullptr, totalBytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
-    if (mmappedData == MAP_FAILED) {
-        // If mmap failed, revert to a read-based approach:
-        // 1) Allocate a buffer of size N * 4
-        // 2) Read from STDIN in chunks until done
-        std::cerr << "[INFO] mmap of STDIN failed, falling back to read()..." << std::endl;
-
-        std::vector<uint32_t> buffer(N);
-        size_t bytesRead = 0;
-        size_t toRead = totalBytes;
-        uint8_t* writePtr = reinterpret_cast<uint8_t*>(buffer.data());
-
-        while (toRead > 0) {
-            ssize_t ret = read(fd, writePtr, toRead);
-            if (ret <= 0) {
-                std::cerr << "Error or EOF on read() before we got all data.\n";
-                return 1;
+    uint64_t sum() const {
+        uint64_t sum = 0;
+        for (uint32_t val : heap_) {
+            sum += val;
+        }
+        return sum;
+    }
+
+    // Kept values, largest first.
+    std::vector<uint32_t> sorted() const {
+        std::vector<uint32_t> values = heap_;
+        std::sort(values.begin(), values.end(), std::greater<uint32_t>());
+        return values;
+    }
+
+    void clear() { heap_.clear(); }
+
+private:
+    size_t k_;
+    std::vector<uint32_t> heap_;
+};
+
+// ---------------------------------------------------------------------------
+// Filtered-scan kernels: feed every value of data[0, n) that is > cutoff into
+// topK and raise cutoff to topK.min() whenever topK is full. Values <= cutoff
+// cannot change the top-K sum (topK, or another thread's heap, already holds
+// K values >= cutoff), and starting from cutoff = 0 only drops zeros, which
+// never change the sum either. Almost every value fails the test, so the
+// SIMD kernels compare a group of vectors against the broadcast cutoff, take
+// the movemask and only drop to scalar code for the rare survivors.
+// ---------------------------------------------------------------------------
+using ScanKernel = void (*)(TopK& topK, const uint32_t* data, size_t n, uint32_t& cutoff);
+
+static inline void feed(TopK& topK, uint32_t val, uint32_t& cutoff) {
+    if (val > cutoff) {
+        topK.push(val);
+        if (topK.full()) {
+            cutoff = std::max(cutoff, topK.min());
+        }
+    }
+}
+
+static void scanScalar(TopK& topK, const uint32_t* data, size_t n, uint32_t& cutoff) {
+    for (size_t i = 0; i < n; ++i) {
+        feed(topK, data[i], cutoff);
+    }
+}
+
+// AVX2 has no unsigned compare, so values and cutoff get their sign bit
+// flipped and are compared signed. 32 values per iteration; the four
+// compare results are ORed so the common all-rejected case is one vptest.
+__attribute__((target("avx2")))
+static void scanAVX2(TopK& topK, const uint32_t* data, size_t n, uint32_t& cutoff) {
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    __m256i limit = _mm256_set1_epi32(static_cast<int>(cutoff ^ 0x80000000u));
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i* src = reinterpret_cast<const __m256i*>(data + i);
+        __m256i gt[4];
+        for (int j = 0; j < 4; ++j) {
+            gt[j] = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_loadu_si256(src + j), bias), limit);
+        }
+        __m256i any = _mm256_or_si256(_mm256_or_si256(gt[0], gt[1]), _mm256_or_si256(gt[2], gt[3]));
+        if (_mm256_testz_si256(any, any)) {
+            continue;
+        }
+        for (int j = 0; j < 4; ++j) {
+            for (unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(gt[j])); mask; mask &= mask - 1) {
+                feed(topK, data[i + 8 * j + __builtin_ctz(mask)], cutoff);
             }
-            bytesRead += ret;
-            writePtr += ret;
-            toRead   -= ret;
         }
+        limit = _mm256_set1_epi32(static_cast<int>(cutoff ^ 0x80000000u));
+    }
+    scanScalar(topK, data + i, n - i, cutoff);
+}
 
-        // We now have all N 32-bit numbers in `buffer`.
-        // Process them with a min-heap of size K to find the top 100.
+// AVX-512 compares unsigned directly into mask registers, 64 values per
+// iteration.
+__attribute__((target("avx512f")))
+static void scanAVX512(TopK& topK, const uint32_t* data, size_t n, uint32_t& cutoff) {
+    __m512i limit = _mm512_set1_epi32(static_cast<int>(cutoff));
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __mmask16 gt[4];
+        for (int j = 0; j < 4; ++j) {
+            gt[j] = _mm512_cmpgt_epu32_mask(_mm512_loadu_si512(data + i + 16 * j), limit);
+        }
+        if ((gt[0] | gt[1] | gt[2] | gt[3]) == 0) {
+            continue;
+        }
+        for (int j = 0; j < 4; ++j) {
+            for (unsigned mask = gt[j]; mask; mask &= mask - 1) {
+                feed(topK, data[i + 16 * j + __builtin_ctz(mask)], cutoff);
+            }
+        }
+        limit = _mm512_set1_epi32(static_cast<int>(cutoff));
+    }
+    scanScalar(topK, data + i, n - i, cutoff);
+}
 
-        std::priority_queue<
-            uint32_t,
-            std::vector<uint32_t>,
-            std::greater<uint32_t>
-        > topK;
+struct KernelInfo {
+    const char* name;
+    ScanKernel fn;
+};
 
-        // Populate initial K
-        size_t i = 0;
-        for (; i < K; ++i) {
-            topK.push(buffer[i]);
-        }
-
-        // Process the rest
-        for (; i < N; ++i) {
-            uint32_t val = buffer[i];
-            if (val > topK.top()) {
-                topK.push(val);
-                if (topK.size() > K) {
-                    topK.pop();
-                }
+// Fastest first, so the first supported entry is the automatic choice.
+static const KernelInfo KERNELS[] = {
+    {"avx512", scanAVX512},
+    {"avx2",   scanAVX2},
+    {"scalar", scanScalar},
+};
+
+static bool kernelSupported(const KernelInfo& k) {
+    __builtin_cpu_init();
+    if (k.fn == scanAVX512) {
+        return __builtin_cpu_supports("avx512f");
+    }
+    if (k.fn == scanAVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    return true;
+}
+
+// Resolve a kernel by name ("auto" = fastest supported). Returns nullptr if
+// the name is unknown or the CPU lacks the instructions.
+static const KernelInfo* selectKernel(const char* name) {
+    for (const auto& k : KERNELS) {
+        if (std::strcmp(name, "auto") == 0 ? kernelSupported(k)
+                                           : std::strcmp(name, k.name) == 0) {
+            return kernelSupported(k) ? &k : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// Streaming top-K engine: a TopK plus its running cutoff, fed one chunk at a
+// time through a scan kernel. Only O(K) state survives between chunks, so
+// the mmap path (the whole mapping, or one block per call in parallel mode)
+// and the read() path (one buffer per call) run the same code and differ
+// only in where the chunks come from.
+class TopKStream {
+public:
+    TopKStream(size_t k, ScanKernel kernel) : topK_(k), kernel_(kernel) {}
+
+    void consume(const uint32_t* data, size_t n) { kernel_(topK_, data, n, cutoff_); }
+
+    // Values <= cutoff() are rejected; raiseCutoff() takes a bound proven
+    // elsewhere (another thread's full heap).
+    uint32_t cutoff() const { return cutoff_; }
+    void raiseCutoff(uint32_t cutoff) { cutoff_ = std::max(cutoff_, cutoff); }
+
+    const TopK& result() const { return topK_; }
+
+    // Start over with an empty heap, keeping the allocation.
+    void reset() {
+        topK_.clear();
+        cutoff_ = 0;
+    }
+
+private:
+    TopK topK_;
+    ScanKernel kernel_;
+    uint32_t cutoff_ = 0;
+};
+
+// Serial top-K sum of data[0, n) with the given kernel.
+static uint64_t serialTopK(const uint32_t* data, size_t n, size_t k, ScanKernel kernel) {
+    TopKStream stream(k, kernel);
+    stream.consume(data, n);
+    return stream.result().sum();
+}
+
+// Parallel scan: every thread keeps a private TopK over its slice and the
+// partial heaps are merged at the end.
+//
+// Once a thread's heap is full its minimum m proves that K values >= m
+// exist, so no value <= m can change the global top-K sum. Threads publish
+// that bound to a shared atomic (max, relaxed ordering: a stale read only
+// makes the filter less selective) and scan with the best bound they have
+// seen as the kernel's cutoff, so after warm-up the heap is almost never
+// touched.
+// The shared bound is exchanged once per block to keep the atomic off the
+// per-value path. Each thread prefaults its own slice with
+// MADV_POPULATE_READ.
+static const size_t SCAN_BLOCK = 64 * 1024;
+
+static uint64_t parallelTopK(const uint32_t* data, size_t n, size_t k, unsigned threads,
+                             ScanKernel kernel) {
+    std::atomic<uint32_t> sharedCutoff{0};
+    std::vector<TopKStream> partial(threads, TopKStream(k, kernel));
+    const size_t slice = (n + threads - 1) / threads;
+    const uintptr_t pageMask = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE)) - 1;
+
+    auto worker = [&](unsigned t) {
+        const size_t first = std::min(n, slice * t);
+        const size_t last  = std::min(n, first + slice);
+        TopKStream& stream = partial[t];
+        if (first == last) {
+            return;
+        }
+        const uintptr_t page = reinterpret_cast<uintptr_t>(data + first) & ~pageMask;
+        madvise(reinterpret_cast<void*>(page),
+                reinterpret_cast<uintptr_t>(data + last) - page, MADV_POPULATE_READ);
+
+        for (size_t b = first; b < last; b += SCAN_BLOCK) {
+            const size_t end = std::min(last, b + SCAN_BLOCK);
+            stream.raiseCutoff(sharedCutoff.load(std::memory_order_relaxed));
+            stream.consume(data + b, end - b);
+            const uint32_t cutoff = stream.cutoff();
+            uint32_t seen = sharedCutoff.load(std::memory_order_relaxed);
+            while (seen < cutoff &&
+                   !sharedCutoff.compare_exchange_weak(seen, cutoff, std::memory_order_relaxed)) {
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0); // the calling thread works too
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    TopK total = partial[0].result();
+    for (unsigned t = 1; t < threads; ++t) {
+        total.merge(partial[t].result());
+    }
+    return total.sum();
+}
+
+// Pipe input is consumed in buffers of this size, two at a time: one being
+// filled by the reader thread while the other is scanned.
+static constexpr size_t STREAM_BUFFER_BYTES = size_t(4) << 20;
+
+// Read `fd` until `len` bytes are in `buf` or EOF. Returns the byte count,
+// or -1 on a read error.
+static ssize_t readFull(int fd, uint8_t* buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = ::read(fd, buf + got, len - got);
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            return -1;
         }
+        if (r == 0) {
+            break;
+        }
+        got += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(got);
+}
+
+// Feed up to maxValues 32-bit integers from `fd` (a pipe or anything else
+// that can't be mapped) into `sink.consume(data, n)`. A reader thread fills
+// one buffer while the other is scanned, so the scan overlaps the read()
+// calls and memory stays at O(K + buffer). Returns the number of values
+// consumed (a trailing partial value is dropped), or -1 on a read error.
+template <typename Sink>
+static ssize_t streamValues(int fd, size_t maxValues, Sink& sink) {
+    // Fewer, larger reads: grow the pipe buffer if the kernel allows it.
+    fcntl(fd, F_SETPIPE_SZ, static_cast<int>(1 << 20));
+
+    struct Slot {
+        std::vector<uint32_t> buf = std::vector<uint32_t>(STREAM_BUFFER_BYTES / sizeof(uint32_t));
+        ssize_t len = 0; // bytes
+        bool full = false;
+        bool last = false;
+    };
+    Slot slots[2];
+    std::mutex m;
+    std::condition_variable cv;
+
+    std::thread reader([&] {
+        size_t remaining = maxValues * sizeof(uint32_t);
+        for (size_t i = 0;; i ^= 1) {
+            Slot& s = slots[i];
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return !s.full; });
+            }
+            const size_t want = std::min(remaining, STREAM_BUFFER_BYTES);
+            ssize_t len = readFull(fd, reinterpret_cast<uint8_t*>(s.buf.data()), want);
+            if (len > 0) {
+                remaining -= static_cast<size_t>(len);
+            }
+            const bool last = len < 0 || static_cast<size_t>(len) < want || remaining == 0;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                s.len = len;
+                s.last = last;
+                s.full = true;
+            }
+            cv.notify_all();
+            if (last) {
+                return; // EOF, error or done; the consumer sees it after this slot
+            }
+        }
+    });
+
+    ssize_t consumed = 0;
+    for (size_t i = 0;; i ^= 1) {
+        Slot& s = slots[i];
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return s.full; });
+        }
+        if (s.len < 0) {
+            consumed = -1;
+            break;
+        }
+        const size_t values = static_cast<size_t>(s.len) / sizeof(uint32_t);
+        sink.consume(s.buf.data(), values);
+        consumed += static_cast<ssize_t>(values);
+        const bool last = s.last;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            s.full = false;
+        }
+        cv.notify_all();
+        if (last) {
+            break;
+        }
+    }
+    reader.join();
+    return consumed;
+}
+
+// ---------------------------------------------------------------------------
+// Windowed mode (--window W [--slide S]). The input is cut into steps of S
+// values (S = W, the default, gives tumbling windows) and after every step
+// the top-K sum of the last W values is printed, one line per step; a
+// trailing partial step counts as a step. Until W values have been seen the
+// window is everything so far.
+//
+// Each step is scanned with the usual TopKStream and reduced to its sorted
+// top-K list. Those lists merge associatively, so the window is a
+// two-stacks queue of step summaries: new steps are merged into a running
+// "back" aggregate, and the "front" stack holds suffix aggregates of the
+// older steps, rebuilt from the back only when it runs empty. Expiring a
+// step is a pop, no window is ever rescanned, and a step costs O(K)
+// amortised on top of its scan, so per-value throughput stays that of the
+// global scan whenever S is well above K.
+// ---------------------------------------------------------------------------
+
+// First k values of the union of two descending lists.
+static std::vector<uint32_t> mergeTopK(const std::vector<uint32_t>& a,
+                                       const std::vector<uint32_t>& b, size_t k) {
+    std::vector<uint32_t> out(std::min(k, a.size() + b.size()));
+    size_t i = 0, j = 0;
+    for (uint32_t& val : out) {
+        val = (j == b.size() || (i < a.size() && a[i] >= b[j])) ? a[i++] : b[j++];
+    }
+    return out;
+}
+
+class SlidingTopK {
+public:
+    SlidingTopK(size_t k, size_t steps) : k_(k), steps_(steps) {}
+
+    // Add the sorted top-K list of the newest step, expiring the oldest
+    // step once the window holds `steps` of them.
+    void push(std::vector<uint32_t> step) {
+        if (front_.size() + back_.size() == steps_) {
+            expire();
+        }
+        backAgg_ = mergeTopK(backAgg_, step, k_);
+        back_.push_back(std::move(step));
+    }
 
-        // Sum the top K
+    // Top-K sum over the steps in the window.
+    uint64_t sum() const {
+        static const std::vector<uint32_t> none;
+        const std::vector<uint32_t>& a = front_.empty() ? none : front_.back();
+        const std::vector<uint32_t>& b = backAgg_;
         uint64_t sum = 0;
-        while (!topK.empty()) {
-            sum += topK.top();
-            topK.pop();
+        size_t i = 0, j = 0;
+        for (size_t n = 0; n < k_ && (i < a.size() || j < b.size()); ++n) {
+            sum += (j == b.size() || (i < a.size() && a[i] >= b[j])) ? a[i++] : b[j++];
         }
+        return sum;
+    }
 
-        std::cout << sum << std::endl;
-        return 0;
+private:
+    void expire() {
+        if (front_.empty()) {
+            // Move the back stack over as suffix aggregates, newest first, so
+            // the oldest step (aggregate of all of them) ends up on top.
+            std::vector<uint32_t> agg;
+            for (size_t i = back_.size(); i-- > 0;) {
+                agg = mergeTopK(back_[i], agg, k_);
+                front_.push_back(agg);
+            }
+            back_.clear();
+            backAgg_.clear();
+        }
+        front_.pop_back();
     }
 
-    // If mmap succeeded, treat mmappedData as an array of uint32_t:
-    const uint32_t* data = static_cast<const uint32_t*>(mmappedData);
+    size_t k_;
+    size_t steps_;
+    std::vector<std::vector<uint32_t>> front_; // suffix aggregates, oldest on top
+    std::vector<std::vector<uint32_t>> back_;  // raw step lists, oldest first
+    std::vector<uint32_t> backAgg_;            // merge of everything in back_
+};
 
-    // Proceed with the min-heap approach:
-    std::priority_queue<
-        uint32_t,
-        std::vector<uint32_t>,
-        std::greater<uint32_t>
-    > topK;
+// Sink that cuts the values it is fed into steps and prints a window sum
+// after each one.
+class WindowedTopK {
+public:
+    WindowedTopK(size_t k, size_t window, size_t slide, ScanKernel kernel, std::ostream& out)
+        : step_(k, kernel), window_(k, window / slide), slide_(slide), out_(out) {}
 
-    // Fill the heap with the first K elements
-    size_t i = 0;
-    for (; i < K; ++i) {
-        topK.push(data[i]);
+    void consume(const uint32_t* data, size_t n) {
+        while (n > 0) {
+            const size_t take = std::min(n, slide_ - filled_);
+            step_.consume(data, take);
+            filled_ += take;
+            data    += take;
+            n       -= take;
+            if (filled_ == slide_) {
+                endStep();
+            }
+        }
     }
 
-    // Process the remainder
-    for (; i < N; ++i) {
-        uint32_t val = data[i];
-        if (val > topK.top()) {
-            topK.push(val);
-            if (topK.size() > K) {
-                topK.pop();
+    // Flush a trailing partial step.
+    void finish() {
+        if (filled_ > 0) {
+            endStep();
+        }
+    }
+
+private:
+    void endStep() {
+        window_.push(step_.result().sorted());
+        out_ << window_.sum() << '\n';
+        step_.reset();
+        filled_ = 0;
+    }
+
+    TopKStream step_;
+    SlidingTopK window_;
+    size_t slide_;
+    size_t filled_ = 0;
+    std::ostream& out_;
+};
+
+// --bench: time every supported kernel on one thread over the whole input
+// and report GB/s (best of 3 runs) on stderr.
+static void runBenchmark(const uint32_t* data, size_t n, size_t k) {
+    std::cerr << std::fixed << std::setprecision(2);
+    for (const auto& kernel : KERNELS) {
+        if (!kernelSupported(kernel)) {
+            continue;
+        }
+        double best = 1e30;
+        uint64_t sum = 0;
+        for (int rep = 0; rep < 3; ++rep) {
+            auto t0 = std::chrono::steady_clock::now();
+            sum = serialTopK(data, n, k, kernel.fn);
+            std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+            best = std::min(best, dt.count());
+        }
+        std::cerr << std::left << std::setw(8) << kernel.name << std::right
+                  << std::setw(8) << (n * sizeof(uint32_t) / best / 1e9) << " GB/s  sum " << sum << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    // "--k K"        sum of the K greatest numbers (default 100)
+    // "--n N"        number of 32-bit integers to read (default: all input)
+    // "--threads T"  scan a regular file with T threads (0 = all hardware
+    //                threads); pipes are scanned as they are read
+    // "--kernel K"   filtered-scan kernel: auto|avx512|avx2|scalar
+    // "--bench"      time every kernel on the input instead of one run
+    //                (regular files only)
+    // "--window W"   print the top-K sum of every window of W values instead
+    //                of one global sum (single-threaded)
+    // "--slide S"    with --window: slide by S values, W a multiple of S
+    //                (default S = W, tumbling windows)
+    size_t K = DEFAULT_K;
+    size_t N = 0;
+    unsigned threads = 1;
+    const char* kernelName = "auto";
+    bool bench = false;
+    size_t window = 0;
+    size_t slide = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--k") == 0 && i + 1 < argc) {
+            K = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--n") == 0 && i + 1 < argc) {
+            N = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernelName = argv[++i];
+        } else if (std::strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (std::strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--slide") == 0 && i + 1 < argc) {
+            slide = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--k K] [--n N] [--threads T] [--kernel K]"
+                      << " [--bench] [--window W [--slide S]]\n";
+            return 1;
+        }
+    }
+    if (slide == 0) {
+        slide = window;
+    }
+    if (window > 0 && window % slide != 0) {
+        std::cerr << "--window must be a multiple of --slide\n";
+        return 1;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const KernelInfo* kernel = selectKernel(kernelName);
+    if (kernel == nullptr) {
+        std::cerr << "Kernel '" << kernelName << "' is unknown or not supported by this CPU\n";
+        return 1;
+    }
+
+    // Try to open "/dev/stdin"
+    int fd = open("/dev/stdin", O_RDONLY);
+
+    // If that fails, fallback to fd=0 (stdin)
+    if (fd < 0) {
+        fd = 0; // File descriptor 0 is standard input
+    }
+
+    // For a regular file N defaults to its size; it is an error to ask for
+    // more values than the file holds.
+    struct stat st;
+    void* mmappedData = MAP_FAILED;
+    size_t totalBytes = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        const size_t available = static_cast<size_t>(st.st_size) / sizeof(uint32_t);
+        if (N == 0) {
+            N = available;
+        } else if (N > available) {
+            std::cerr << "Input holds only " << available << " integers, " << N << " requested\n";
+            return 1;
+        }
+        totalBytes = N * sizeof(uint32_t);
+        if (N == 0) {
+            if (window == 0) {
+                std::cout << 0 << std::endl;
             }
+            return 0;
         }
+        // In parallel mode the workers prefault their own slices.
+        mmappedData = mmap(nullptr, totalBytes, PROT_READ,
+                           MAP_PRIVATE | (threads > 1 ? 0 : MAP_POPULATE), fd, 0);
     }
+    // In many environments, mmap of a pipe or certain STDIN streams may fail;
+    // then the same engine is fed from read() as the data arrives.
+    if (mmappedData == MAP_FAILED) {
+        if (bench) {
+            std::cerr << "--bench needs a regular file on stdin\n";
+            return 1;
+        }
+        std::cerr << "[INFO] mmap of STDIN failed, streaming with read()..." << std::endl;
 
-    // Sum the top K
-    uint64_t sum = 0;
-    while (!topK.empty()) {
-        sum += topK.top();
-        topK.pop();
+        const size_t maxValues = N ? N : SIZE_MAX / sizeof(uint32_t);
+        ssize_t got;
+        uint64_t sum = 0;
+        if (window) {
+            // Windows are printed as they complete.
+            WindowedTopK windowed(K, window, slide, kernel->fn, std::cout);
+            got = streamValues(fd, maxValues, windowed);
+            if (got >= 0) {
+                windowed.finish();
+            }
+        } else {
+            TopKStream stream(K, kernel->fn);
+            got = streamValues(fd, maxValues, stream);
+            sum = stream.result().sum();
+        }
+        if (got < 0) {
+            std::perror("read");
+            return 1;
+        }
+        if (N && static_cast<size_t>(got) < N) {
+            std::cerr << "Error or EOF on read() before we got all data.\n";
+            return 1;
+        }
+
+        if (!window) {
+            std::cout << sum << std::endl;
+        }
+        return 0;
     }
 
-    std::cout << sum << std::endl;
+    // If mmap succeeded, treat mmappedData as an array of uint32_t:
+    const uint32_t* data = static_cast<const uint32_t*>(mmappedData);
+
+    // Proceed with the min-heap approach (one private heap per thread in
+    // parallel mode, merged at the end):
+    if (bench) {
+        runBenchmark(data, N, K);
+    } else if (window) {
+        WindowedTopK windowed(K, window, slide, kernel->fn, std::cout);
+        windowed.consume(data, N);
+        windowed.finish();
+    } else {
+        uint64_t sum = threads > 1 ? parallelTopK(data, N, K, threads, kernel->fn)
+                                   : serialTopK(data, N, K, kernel->fn);
+        std::cout << sum << std::endl;
+    }
 
     munmap(mmappedData, totalBytes);
     close(fd);